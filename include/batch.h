@@ -0,0 +1,20 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "containers.h"
+#include "index/create.h"
+#include "index/filter.h"
+
+namespace batch
+{
+    /**
+    @brief Runs the jobs of the job file (g_config.jobs) back to back.
+     * Each dataset is loaded once and kept in memory until its last job. Its index is rebuilt only when
+     * a job uses different partitions per dimension or global dataspace bounds than the previous one
+     * (with the quadtree index, the tree is built for each job and the datasets are always re-indexed; 
+     * with the R-tree index, each dataset's tree is built once).
+     */
+    DB_STATUS run();
+}
+
+#endif
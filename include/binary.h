@@ -0,0 +1,73 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+#include "def.h"
+#include "containers.h"
+
+/**
+@brief Binary (.dat) dataset format.
+ *
+ * Layout (all sections 8-byte aligned, native byte order):
+ *  - Header
+ *  - ObjectRecord[objectCount]: record ID, data type, MBR, first ring and ring count, name ID
+ *  - RingRecord[ringCount]: vertex offset, vertex count and whether the ring is an outer ring (starts a new polygon)
+ *  - double[2 * vertexCount]: the vertices (x,y)
+ *  - uint64_t[nameCount + 1]: offsets of the names in the name bytes
+ *  - char[nameBytes]: the (deduplicated) name dictionary
+ *
+ * Geometries are stored already corrected and validated, so loading involves no text parsing or validation. 
+ * Names are stored in their final form (incl. the dataset description/other column of the source dataset).
+ */
+namespace binary
+{
+    const char DAT_MAGIC[8] = {'S', 'P', 'T', 'X', 'D', 'A', 'T', '\0'};
+    const uint32_t DAT_VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t objectCount;
+        uint64_t ringCount;
+        uint64_t vertexCount;
+        uint64_t nameCount;
+        uint64_t nameBytes;
+    };
+
+    struct ObjectRecord {
+        uint64_t recID;
+        int32_t dataType;
+        uint32_t nameID;
+        double xMin, yMin, xMax, yMax;
+        uint64_t ringOffset;
+        uint64_t ringCount;
+    };
+
+    struct RingRecord {
+        uint64_t vertexOffset;
+        uint32_t vertexCount;
+        uint32_t outer;
+    };
+
+    /** @brief Writes the objects in the binary layout (header and all sections) at the stream's current position. */
+    DB_STATUS writeObjects(std::ofstream &fout, std::vector<Shape*> &objects);
+
+    /**
+    @brief Builds the objects stored in binary layout in the given memory region, in parallel. 
+     * The object records are split into contiguous ranges, one per thread, so the chunks remain in stored order.
+     * @param[out] chunkObjects The objects (with MBRs set), one list per chunk.
+     */
+    DB_STATUS readObjects(const char* data, size_t size, std::vector<std::vector<Shape>> &chunkObjects);
+
+    /** @brief Writes the given (loaded) objects to a binary dataset file, in chunk order. */
+    DB_STATUS writeDataset(std::string &path, std::vector<std::vector<Shape>> &chunkObjects);
+
+    /** @brief Loads the objects of a binary dataset from the memory-mapped file (see readObjects). */
+    DB_STATUS loadDataset(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects);
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <mutex>
+#include <list>
+#include <atomic>
+
+#include "def.h"
+#include "containers.h"
+
+/**
+@brief Cache of materialized geometries for the lazy shapes of a dataset.
+ *
+ * Lazy shapes keep only their MBR, name, centroid and the offset of their line in the dataset file. 
+ * On access, the line is read again and parsed into a full Shape, which is cached. Entries are spread 
+ * across shards with their own lock and LRU list. If a memory cap is set, the least recently used 
+ * entries of a shard are evicted once the shard exceeds its share of the cap. Evicted shapes stay alive 
+ * as long as a caller holds them.
+ */
+struct GeometryCache {
+private:
+    static const int NUM_SHARDS = 64;
+
+    struct Entry {
+        std::shared_ptr<Shape> shape;
+        size_t bytes;
+        std::list<size_t>::iterator lruIt;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<size_t, Entry> entries;
+        // most recently used first
+        std::list<size_t> lru;
+        size_t bytes = 0;
+    };
+
+    Dataset* dataset;
+    int fd = -1;
+    size_t shardCapacityBytes;
+    Shard shards[NUM_SHARDS];
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> evictions{0};
+
+    /** @brief Reads and parses the object's line from the dataset file. */
+    DB_STATUS materialize(Shape* object, std::shared_ptr<Shape> &geometry);
+
+public:
+    /** @param capacityBytes The memory cap of the cache (0: unlimited). */
+    GeometryCache(Dataset* dataset, size_t capacityBytes);
+    ~GeometryCache();
+
+    /** @brief Opens the dataset file for reading. */
+    DB_STATUS open();
+
+    /**
+    @brief Returns the shape holding the object's full geometry: the object itself if it is not lazy, 
+     * otherwise its (cached) materialized copy, which is kept alive by 'holder'.
+     * @param insert If false, a geometry that is not cached is materialized only for the caller (e.g. a single pass 
+     * over the whole dataset), without being cached, counted in the statistics or moved in the LRU order.
+     * @return nullptr on failure.
+     */
+    static Shape* getGeometry(Shape* object, std::shared_ptr<Shape> &holder, bool insert = true);
+
+    void printStatistics();
+};
+
+#endif
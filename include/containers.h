@@ -2,11 +2,15 @@
 #define CONTAINERS_H
 
 #include <variant>
+#include <memory>
+#include <mutex>
+#include <deque>
 #include <any>
 #include <fstream>
 
 #include "def.h"
 #include "utils.h"
+#include "wkt.h"
 
 struct DatasetStatement
 {
@@ -29,9 +33,19 @@ struct OutputStatement
 };
 
 struct ArgumentsStatement
+{
+    DatasetStatement datasetR;
+    /** @brief The S datasets, in the order of the -S arguments (several for a multi-way join). */
+    std::vector<DatasetStatement> datasetsS;
+    OutputStatement outputStmt;
+};
+
+/** @brief A single join of a job file (batch mode). */
+struct JobStatement
 {
     DatasetStatement datasetR;
     DatasetStatement datasetS;
+    int partitionsPerDim = -1;
     OutputStatement outputStmt;
 };
 
@@ -55,6 +69,25 @@ struct MBR {
     MBR() : pMin(Point(std::numeric_limits<int>::max(), std::numeric_limits<int>::max())), pMax(Point(-std::numeric_limits<int>::max(), -std::numeric_limits<int>::max())) {}
 };
 
+/** @brief Encodes a DE-9IM matrix into its empty/non-empty cell bits (see De9imCode). */
+inline De9imCode encodeDe9imMatrix(const boost::geometry::de9im::matrix &matrix) {
+    De9imCode code = 0;
+    for (int i=0; i<9; i++) {
+        if (matrix[i] != 'F') {
+            code |= 1 << i;
+        }
+    }
+    return code;
+}
+
+/** @brief True for the boost geometry types with an area (polygons and multipolygons). */
+template<typename GeometryType>
+struct IsArealGeometry : std::false_type {};
+template<>
+struct IsArealGeometry<bg_polygon> : std::true_type {};
+template<>
+struct IsArealGeometry<bg_multi_polygon> : std::true_type {};
+
 /**
  * @brief Wrapper class for the Geometry objects.
  * 
@@ -84,7 +117,16 @@ public:
         return empty;
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        logger::log_error(DBERR_INVALID_OPERATION, "Geometry wrapper can be accessed directly for operation: forEachRing");
+    }
+
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        logger::log_error(DBERR_INVALID_OPERATION, "Geometry wrapper can be accessed directly for operation: addRing");
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
         logger::log_error(DBERR_INVALID_OPERATION, "Geometry wrapper can be accessed directly for operation: setFromWKT");
         return DBERR_INVALID_OPERATION;
     }
@@ -139,9 +181,9 @@ public:
     }
 
     template<typename OtherGeometryType>
-    std::string createMaskCode(const GeometryWrapper<OtherGeometryType> &other) const {
+    De9imCode createMaskCode(const GeometryWrapper<OtherGeometryType> &other) const {
         logger::log_error(DBERR_INVALID_OPERATION, "createMaskCode unsupported for the invoked shapes.");
-        return "";
+        return DE9IM_CODE_INVALID;
     }
 
     template<typename OtherBoostGeometryObj>
@@ -233,21 +275,22 @@ public:
         return this->geometry;
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
-        // check if it is correct
-        if (wktText.find("POINT") == std::string::npos) {
-            // it is not a polygon WKT, ignore
-            // logger::log_warning("WKT text passed into set from WKT is not a point:", wktText);
-            return DBERR_INVALID_GEOMETRY;
-        }
-        // special case, it might be multi
-        if (wktText.find("MULTIPOINT") != std::string::npos) {
-            // it is a multipoint wkt, ignore
-            // logger::log_warning("WKT text passed into set from WKT is a multipoint:", wktText);
-            return DBERR_INVALID_GEOMETRY;
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        func(&geometry, 1, true);
+    }
+
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        geometry = points[0];
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
+        // load (DBERR_INVALID_GEOMETRY if tagged as a different type, e.g. a multi-geometry, DBERR_INVALID_WKT if malformed)
+        DB_STATUS ret = wkt::parse(wktText, geometry);
+        if (ret != DBERR_OK) {
+            reset();
+            return ret;
         }
-        // load
-        boost::geometry::read_wkt(wktText, geometry);
         // correct
         correctGeometry();
         // check if valid
@@ -289,11 +332,11 @@ public:
      * queries
      */
 
-    std::string createMaskCode(const GeometryWrapper<bg_polygon>& other) const;
-    std::string createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {return "";}
-    std::string createMaskCode(const GeometryWrapper<bg_linestring>& other) const {return "";}
-    std::string createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return "";}
-    std::string createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const;
+    De9imCode createMaskCode(const GeometryWrapper<bg_polygon>& other) const;
+    De9imCode createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {return DE9IM_CODE_INVALID;}
+    De9imCode createMaskCode(const GeometryWrapper<bg_linestring>& other) const {return DE9IM_CODE_INVALID;}
+    De9imCode createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return DE9IM_CODE_INVALID;}
+    De9imCode createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const;
 
     template<typename OtherBoostGeometryObj>
     bool intersects(const OtherBoostGeometryObj &other) const {
@@ -365,15 +408,24 @@ public:
         envelope = geometry;
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
-        // check if it is correct
-        if (wktText.find("BOX") == std::string::npos) {
-            // it is not a rectangle WKT, ignore
-            // logger::log_warning("WKT text passed into set from WKT is not a rectangle (box):", wktText);
-            return DBERR_INVALID_GEOMETRY;
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        bg_point_xy corners[2] = {geometry.min_corner(), geometry.max_corner()};
+        func(corners, 2, true);
+    }
+
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        geometry.min_corner() = points[0];
+        geometry.max_corner() = points[1];
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
+        // load (DBERR_INVALID_GEOMETRY if tagged as a different type, e.g. a multi-geometry, DBERR_INVALID_WKT if malformed)
+        DB_STATUS ret = wkt::parse(wktText, geometry);
+        if (ret != DBERR_OK) {
+            reset();
+            return ret;
         }
-        // load
-        boost::geometry::read_wkt(wktText, geometry);
         // correct
         correctGeometry();
         // check if valid
@@ -448,9 +500,9 @@ public:
      */
     
     template<typename OtherGeometryType>
-    std::string createMaskCode(const GeometryWrapper<OtherGeometryType> &other) const {
+    De9imCode createMaskCode(const GeometryWrapper<OtherGeometryType> &other) const {
         logger::log_error(DBERR_INVALID_OPERATION, "createMaskCode unsupported for the invoked shapes.");
-        return "";
+        return DE9IM_CODE_INVALID;
     }
 
     template<typename OtherBoostGeometryObj>
@@ -531,21 +583,22 @@ public:
         return false;
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
-        // check if it is correct
-        if (wktText.find("LINESTRING") == std::string::npos) {
-            // it is not a polygon WKT, ignore
-            // logger::log_warning("WKT text passed into set from WKT is not a linestring:", wktText);
-            return DBERR_INVALID_GEOMETRY;
-        }
-        // special case, it might be multi
-        if (wktText.find("MULTILINESTRING") != std::string::npos) {
-            // it is a multilinestring wkt, ignore
-            // logger::log_warning("WKT text passed into set from WKT is a multilinestring:", wktText);
-            return DBERR_INVALID_GEOMETRY;
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        func(geometry.data(), geometry.size(), true);
+    }
+
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        geometry.assign(points, points + count);
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
+        // load (DBERR_INVALID_GEOMETRY if tagged as a different type, e.g. a multi-geometry, DBERR_INVALID_WKT if malformed)
+        DB_STATUS ret = wkt::parse(wktText, geometry);
+        if (ret != DBERR_OK) {
+            reset();
+            return ret;
         }
-        // load
-        boost::geometry::read_wkt(wktText, geometry);
         // correct
         correctGeometry();
         // check if valid
@@ -594,14 +647,13 @@ public:
 
     // topology
     // declaration
-    std::string createMaskCode(const GeometryWrapper<bg_polygon>& other) const;
-    std::string createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const;
-    std::string createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {return "";}
-    std::string createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return "";}
+    De9imCode createMaskCode(const GeometryWrapper<bg_polygon>& other) const;
+    De9imCode createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const;
+    De9imCode createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {return DE9IM_CODE_INVALID;}
+    De9imCode createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return DE9IM_CODE_INVALID;}
     // definitions
-    std::string createMaskCode(const GeometryWrapper<bg_linestring>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_linestring>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
     
     template<typename OtherBoostGeometryObj>
@@ -675,21 +727,30 @@ public:
         boost::geometry::envelope(geometry, envelope);
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
-        // check if it is correct
-        if (wktText.find("POLYGON") == std::string::npos) {
-            // it is not a polygon WKT, ignore
-            // logger::log_warning("WKT text passed into set point from WKT is not a polygon:", wktText);
-            return DBERR_INVALID_GEOMETRY;
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        func(geometry.outer().data(), geometry.outer().size(), true);
+        for (auto &inner : geometry.inners()) {
+            func(inner.data(), inner.size(), false);
         }
-        // special case, it might be multipolygon
-        if (wktText.find("MULTIPOLYGON") != std::string::npos) {
-            // it is a multipolygon wkt, ignore
-            // logger::log_warning("WKT text passed into set polygon from WKT is a multipolygon:", wktText);
-            return DBERR_INVALID_GEOMETRY;
+    }
+
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        if (outer) {
+            geometry.outer().assign(points, points + count);
+        } else {
+            geometry.inners().emplace_back();
+            geometry.inners().back().assign(points, points + count);
+        }
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
+        // load (DBERR_INVALID_GEOMETRY if tagged as a different type, e.g. a multi-geometry, DBERR_INVALID_WKT if malformed)
+        DB_STATUS ret = wkt::parse(wktText, geometry);
+        if (ret != DBERR_OK) {
+            reset();
+            return ret;
         }
-        // load
-        boost::geometry::read_wkt(wktText, geometry);
         // correct
         correctGeometry();
         // check if valid
@@ -766,19 +827,16 @@ public:
     }
 
     // topology definitions
-    std::string createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return "";};
-    std::string createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const;
-    std::string createMaskCode(const GeometryWrapper<bg_polygon>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return DE9IM_CODE_INVALID;};
+    De9imCode createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const;
+    De9imCode createMaskCode(const GeometryWrapper<bg_polygon>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
-    std::string createMaskCode(const GeometryWrapper<bg_linestring>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_linestring>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
-    std::string createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
 
     template<typename OtherBoostGeometryObj>
@@ -858,15 +916,34 @@ public:
         boost::geometry::envelope(geometry, envelope);
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
-        // check if it is correct
-        if (wktText.find("MULTIPOLYGON") == std::string::npos) {
-            // it is not a multipolygon WKT, ignore
-            // logger::log_warning("WKT text passed into set point from WKT is not a polygon:", wktText);
-            return DBERR_INVALID_GEOMETRY;
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        for (auto &polygon : geometry) {
+            func(polygon.outer().data(), polygon.outer().size(), true);
+            for (auto &inner : polygon.inners()) {
+                func(inner.data(), inner.size(), false);
+            }
+        }
+    }
+
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        if (outer) {
+            // an outer ring starts a new polygon
+            geometry.emplace_back();
+            geometry.back().outer().assign(points, points + count);
+        } else {
+            geometry.back().inners().emplace_back();
+            geometry.back().inners().back().assign(points, points + count);
+        }
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
+        // load (DBERR_INVALID_GEOMETRY if tagged as a different type, e.g. a multi-geometry, DBERR_INVALID_WKT if malformed)
+        DB_STATUS ret = wkt::parse(wktText, geometry);
+        if (ret != DBERR_OK) {
+            reset();
+            return ret;
         }
-        // load
-        boost::geometry::read_wkt(wktText, geometry);
         // correct
         correctGeometry();
         // check if valid
@@ -940,8 +1017,7 @@ public:
     }
 
     int getVertexCount() const {
-        logger::log_error(DBERR_INVALID_OPERATION, "Method 'getVertexCount()' not supported for multi polygon shape.");
-        return -1;
+        return boost::geometry::num_points(geometry);
     }
 
     // APRIL
@@ -950,22 +1026,18 @@ public:
     }
 
     // topology definitions
-    std::string createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return "";};
-    std::string createMaskCode(const GeometryWrapper<bg_polygon>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_rectangle>& other) const {return DE9IM_CODE_INVALID;};
+    De9imCode createMaskCode(const GeometryWrapper<bg_polygon>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
-    std::string createMaskCode(const GeometryWrapper<bg_linestring>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_linestring>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
-    std::string createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_point_xy>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
-    std::string createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const {
-        boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-        return matrix.str();
+    De9imCode createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const {
+        return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
     }
 
     template<typename OtherBoostGeometryObj>
@@ -1031,13 +1103,11 @@ public:
  * They had to be forward-declared and later defined because of dependencies.
  */
 /** @brief Overloaded method for creating the DE-9IM mask code for Linestring-Polygon cases.*/
-inline std::string GeometryWrapper<bg_linestring>::createMaskCode(const GeometryWrapper<bg_polygon>& other) const {
-    boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-    return matrix.str();
+inline De9imCode GeometryWrapper<bg_linestring>::createMaskCode(const GeometryWrapper<bg_polygon>& other) const {
+    return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
 }
-inline std::string GeometryWrapper<bg_linestring>::createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const {
-    boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-    return matrix.str();
+inline De9imCode GeometryWrapper<bg_linestring>::createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const {
+    return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
 }
 inline double GeometryWrapper<bg_linestring>::getIntersectionArea(const GeometryWrapper<bg_polygon> &other) const {return 0.0f;}
 inline double GeometryWrapper<bg_linestring>::getIntersectionArea(const GeometryWrapper<bg_multi_polygon> &other) const {return 0.0f;}
@@ -1060,14 +1130,12 @@ inline bool GeometryWrapper<bg_linestring>::meets(const GeometryWrapper<bg_multi
 }
 
 /** @brief Overloaded method for creating the DE-9IM mask code for Point-Polygon cases.*/
-inline std::string GeometryWrapper<bg_point_xy>::createMaskCode(const GeometryWrapper<bg_polygon>& other) const  {
-    boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-    return matrix.str();
+inline De9imCode GeometryWrapper<bg_point_xy>::createMaskCode(const GeometryWrapper<bg_polygon>& other) const  {
+    return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
 }
 /** @brief Overloaded method for creating the DE-9IM mask code for Point-MultiPolygon cases.*/
-inline std::string GeometryWrapper<bg_point_xy>::createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const  {
-    boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-    return matrix.str();
+inline De9imCode GeometryWrapper<bg_point_xy>::createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const  {
+    return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
 }
 /** @brief Overloaded method for the 'inside' relate predicate query for Point-Linestring cases.*/
 inline bool GeometryWrapper<bg_point_xy>::inside(const GeometryWrapper<bg_linestring> &other) const {
@@ -1113,9 +1181,8 @@ inline double GeometryWrapper<bg_polygon>::getIntersectionArea(const GeometryWra
     }
     return convertDegreesToSquareKilometers(degreeArea, getCentroid().y());
 }
-inline std::string GeometryWrapper<bg_polygon>::createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const {
-    boost::geometry::de9im::matrix matrix = boost::geometry::relation(geometry, other.geometry);
-    return matrix.str();
+inline De9imCode GeometryWrapper<bg_polygon>::createMaskCode(const GeometryWrapper<bg_multi_polygon>& other) const {
+    return encodeDe9imMatrix(boost::geometry::relation(geometry, other.geometry));
 }
 inline bool GeometryWrapper<bg_polygon>::inside(const GeometryWrapper<bg_multi_polygon>& other) const {
     return boost::geometry::within(geometry, other.geometry);
@@ -1142,6 +1209,18 @@ using RectangleWrapper = GeometryWrapper<bg_rectangle>;
 /** @typedef RectangleWrapper @brief type definition for the rectangle wrapper*/
 using MultiPolygonWrapper = GeometryWrapper<bg_multi_polygon>;
 
+struct GeometryCache;
+
+/**
+@brief The APRIL approximation of an areal object on the APRIL grid (see april::build): the numbers of the cells that it covers 
+ * along the grid's Hilbert curve, as sorted, disjoint and non-adjacent intervals [first, last], flattened in pairs.
+ * ALL intervals hold the cells that the object intersects, FULL intervals the cells that lie in its interior.
+ */
+struct AprilData {
+    std::vector<uint32_t> allIntervals;
+    std::vector<uint32_t> fullIntervals;
+};
+
 /** @typedef ShapeVariant @brief All the allowed Shape variants (geometry wrappers). */
 using ShapeVariant = std::variant<PointWrapper, PolygonWrapper, LineStringWrapper, RectangleWrapper, MultiPolygonWrapper>;
 
@@ -1159,11 +1238,13 @@ private:
      * @warning Direct access is not encouraged. See the member method definitions for more.
      */
     ShapeVariant shape;
-    std::vector<int> partitions;
-    int partitionCount;
     double perc = 0.85;
     double xExtentPerc = 0;
     double yExtentPerc = 0;
+    /** @brief The cached centroid of lazy shapes (whose geometry is not held in memory). */
+    bg_point_xy lazyCentroid;
+    /** @brief The cached point count of lazy shapes. */
+    int lazyVertexCount = 0;
 public:
     /** @brief the object's ID, as read by the data file. */
     size_t recID;
@@ -1171,8 +1252,21 @@ public:
     DataType type;
     /** @brief the object's MBR. */
     MBR mbr;
-    /** @brief the entity's name */
-    std::string name;
+    /** @brief the entity's name ID in the name pool (see getName()) */
+    uint32_t nameID = 0;
+    /** @brief lazy shapes only: the cache that materializes the shape's geometry on demand (nullptr if the geometry is held by the shape). */
+    GeometryCache* geometryCache = nullptr;
+    /** @brief lazy shapes only: byte offset of the object's line in the dataset file. */
+    size_t fileOffset = 0;
+    /** @brief lazy shapes only: length of the object's line in the dataset file. */
+    size_t lineLength = 0;
+    /** 
+    @brief The range of grid cells [minCellX, maxCellX] x [minCellY, maxCellY] that the object's MBR intersects, 
+     * set when it is indexed (empty otherwise). For the quadtree, cells of the 2^depth grid that its leaves are aligned to.
+     */
+    int minCellX = 0, minCellY = 0, maxCellX = -1, maxCellY = -1;
+    /** @brief areal objects only: the object's APRIL approximation, held by its dataset (nullptr if not built, and always in materialized copies). */
+    const AprilData* aprilData = nullptr;
     /** @brief Default empty Shape constructor. */
     Shape() {}
 
@@ -1201,38 +1295,21 @@ public:
         }, shape);
     }
 
-    /** @brief Returns the partition ID for partition number 'partitionIndex' in the partitions list.
-     * @param partitionIndex indicates the offset (index) of the requested partition from [0, partitionCount-1].
-     */
-    inline int getPartitionID(int partitionIndex) {
-        return partitions[partitionIndex];
-    }
-
-    /** @brief Sets the object's partitions (partitionCount in total) to the given list of partitions.
-     * @param newPartitions Contains consecutive double values that represent pairs <partitionID, classType>. 
-     * Has size partitionCount.
-     * @param partitionCount The total number of partitions represented by the list.
-     */
-    inline void setPartitions(std::vector<int> &newPartitions, int partitionCount) {
-        this->partitionCount = partitionCount;
-        this->partitions = newPartitions;
+    /** @brief Sets the object's range of grid cells. */
+    inline void setCellRange(int minX, int minY, int maxX, int maxY) {
+        minCellX = minX;
+        minCellY = minY;
+        maxCellX = maxX;
+        maxCellY = maxY;
     }
 
-    /** @brief Initializes the list of partitions based on the input partition ids. */
-    inline void initPartitions(std::vector<int> &partitionIDs) {
-        partitionCount = partitionIDs.size();
-        partitions.reserve(partitionCount);
-        for (auto &it: partitionIDs) {
-            partitions.push_back(it);
-        }
+    /** @brief Empties the object's range of grid cells (the object is not in any partition). */
+    inline void clearCellRange() {
+        setCellRange(0, 0, -1, -1);
     }
 
-    inline std::vector<int>* getPartitionIDs() {
-        return &this->partitions;
-    }
-
-    inline int getPartitionCount() {
-        return partitionCount;
+    inline bool hasCellRange() {
+        return maxCellX >= minCellX && maxCellY >= minCellY;
     }
 
     /** @brief Sets the shape's mbr. If the max values are larger than the min values, it fixes this by swapping them. */
@@ -1286,21 +1363,43 @@ public:
         }, shape);
     }
 
+    /** @brief Returns the entity's name (interned in the name pool). */
+    inline std::string_view getName() const;
+
     /** @brief Returns the centroid of the shape */
     bg_point_xy getCentroid() {
+        if (geometryCache != nullptr) {
+            return lazyCentroid;
+        }
         return std::visit([](auto&& arg) {
             return arg.getCentroid();
         }, shape);
     }
 
+    /**
+    @brief Turns the shape into a lazy shape: its centroid is cached and its geometry memory is released. 
+     * The geometry is materialized again from the dataset file through the given cache (see GeometryCache).
+     * @warning The MBR must be set.
+     */
+    void makeLazy(GeometryCache* cache, size_t offset, size_t length) {
+        lazyCentroid = getCentroid();
+        lazyVertexCount = getVertexCount();
+        std::visit([](auto&& arg) {
+            // replace with a fresh (empty) wrapper so the geometry's memory is actually freed
+            arg = std::decay_t<decltype(arg)>();
+        }, shape);
+        geometryCache = cache;
+        fileOffset = offset;
+        lineLength = length;
+    }
+
     /** @brief Resets the boost geometry object. */
     void reset() {
         recID = 0;
         resetMBR();
-        partitions.clear();
-        partitionCount = 0;
+        clearCellRange();
         resetPoints();
-        name = "";
+        nameID = 0;
     }
 
     /** @brief Adds a point to the boost geometry (see derived method definitions). */
@@ -1347,7 +1446,23 @@ public:
         correctGeometry();
     }
 
-    DB_STATUS setFromWKT(std::string &wktText) {
+    /** @brief Calls func(points, count, isOuter) for each point sequence of the geometry, in order 
+     * (outer/inner rings for polygons, a single sequence for the other types). */
+    template<typename Func>
+    void forEachRing(Func &&func) const {
+        std::visit([&func](auto&& arg) {
+            arg.forEachRing(func);
+        }, shape);
+    }
+
+    /** @brief Appends a point sequence to the geometry, as given by forEachRing(). An outer ring starts a new polygon. */
+    void addRing(const bg_point_xy* points, size_t count, bool outer) {
+        std::visit([points, count, outer](auto&& arg) {
+            arg.addRing(points, count, outer);
+        }, shape);
+    }
+
+    DB_STATUS setFromWKT(std::string_view wktText) {
         return std::visit([&wktText](auto&& arg) {
             return arg.setFromWKT(wktText);
         }, shape);
@@ -1381,6 +1496,9 @@ public:
 
     /** @brief Returns the point count of the geometry. */
     int getVertexCount() {
+        if (geometryCache != nullptr) {
+            return lazyVertexCount;
+        }
         return std::visit([](auto&& arg) -> int {
             return arg.getVertexCount();
         }, shape);
@@ -1393,17 +1511,64 @@ public:
         }, shape);
     }
 
-    /** @brief Generates and returns the DE-9IM mask of this geometry (as R) with the input geometry (as S) 
+    /** @brief Generates and returns the (encoded) DE-9IM matrix of this geometry (as R) with the input geometry (as S) 
      * @warning Not all geometry type combinations are supported (see data type support).
     */
-    std::string createMaskCode(const Shape &other) const {
-        return std::visit([&other](auto&& arg) -> std::string {
-            return std::visit([&arg](auto&& otherArg) -> std::string {
+    De9imCode createMaskCode(const Shape &other) const {
+        return std::visit([&other](auto&& arg) -> De9imCode {
+            return std::visit([&arg](auto&& otherArg) -> De9imCode {
                 return arg.createMaskCode(otherArg);
             }, other.shape);
         }, shape);
     }
 
+    /** @brief Returns true for polygons and multipolygons. */
+    bool isAreal() const {
+        return type == DT_POLYGON || type == DT_MULTIPOLYGON;
+    }
+
+    /**
+    @brief Returns true if this geometry (as R) and the input geometry (as S) match the DE-9IM mask, or any mask of a 
+     * mask sequence (see boost::geometry::de9im). Boost stops relating the geometries as soon as the answer is decided.
+     * @warning Only areal geometries are supported (see isAreal()).
+    */
+    template<typename Mask>
+    bool relate(const Shape &other, const Mask &mask) const {
+        return std::visit([&other, &mask](auto&& arg) -> bool {
+            return std::visit([&arg, &mask](auto&& otherArg) -> bool {
+                if constexpr (IsArealGeometry<std::decay_t<decltype(arg.geometry)>>::value && IsArealGeometry<std::decay_t<decltype(otherArg.geometry)>>::value) {
+                    return boost::geometry::relate(arg.geometry, otherArg.geometry, mask);
+                } else {
+                    logger::log_error(DBERR_INVALID_OPERATION, "relate unsupported for the invoked shapes.");
+                    return false;
+                }
+            }, other.shape);
+        }, shape);
+    }
+
+    /**
+    @brief Returns the location of this geometry's first vertex in the input geometry (a single point-in-polygon pass).
+     * Both geometries must be areal, PL_UNDECIDED is returned otherwise.
+    */
+    PointLocation locateFirstVertex(const Shape &other) const {
+        return std::visit([&other](auto&& arg) -> PointLocation {
+            return std::visit([&arg](auto&& otherArg) -> PointLocation {
+                if constexpr (IsArealGeometry<std::decay_t<decltype(arg.geometry)>>::value && IsArealGeometry<std::decay_t<decltype(otherArg.geometry)>>::value) {
+                    if (boost::geometry::num_points(arg.geometry) == 0) {
+                        return PL_UNDECIDED;
+                    }
+                    boost::geometry::de9im::matrix matrix = boost::geometry::relation(*boost::geometry::points_begin(arg.geometry), otherArg.geometry);
+                    if (matrix[0] != 'F') {
+                        return PL_INTERIOR;
+                    }
+                    return matrix[1] != 'F' ? PL_BOUNDARY : PL_EXTERIOR;
+                } else {
+                    return PL_UNDECIDED;
+                }
+            }, other.shape);
+        }, shape);
+    }
+
     /** @brief Returns true whether the input geometry intersects (border or area) with this geometry. False otherwise. 
      * @warning Not all geometry type combinations are supported (see data type support).
     */
@@ -1540,14 +1705,30 @@ struct DataspaceMetadata {
     void clear();
 };
 
+/** 
+@brief The objects of one two-layer index class of a partition. Their MBRs are kept next to the object 
+ * references as contiguous arrays (structure of arrays), so that the join filter does not dereference the objects.
+ */
+struct ClassContents {
+    std::vector<Shape*> objects;
+    std::vector<double> xMin, yMin, xMax, yMax;
+
+    void addObject(Shape* objectRef);
+    /** @brief Refills the MBR arrays from the objects (after the objects are reordered). */
+    void refreshMBRs();
+    size_t size() {
+        return objects.size();
+    }
+};
+
 /** @brief Holds all necessary partition information. 
  * @param partitionID The partition's ID in the grid.
  * @param classIndex Fixed 4 position vector, one for each two-layer index class.
  */
 struct Partition {
     int partitionID;
-    /** @brief Contains the list of object pointers (Shape*) for this partition */
-    std::vector<Shape*> contents;
+    /** @brief Contains the objects of this partition, for each two-layer index class (A, B, C, D). */
+    ClassContents classIndex[4];
     /**
     @brief Default constructor that defines the 4-position vector. Two-layer index classes: A, B, C, D
      */
@@ -1555,28 +1736,72 @@ struct Partition {
         partitionID = id;
     }
 
-    /** @brief Returns a reference to the partition's contents */
-    std::vector<Shape*>* getContents();
-    void addObject(Shape *objectRef);
+    /** @brief Returns a reference to the partition's contents of the given class */
+    ClassContents* getContents(TwoLayerClass objectClass);
+    void addObject(Shape *objectRef, TwoLayerClass objectClass);
+    /** @brief Returns the number of objects in the partition (all classes). */
+    size_t getObjectCount();
+};
+
+/**
+@brief A block of BLOCK_SIDE x BLOCK_SIDE grid cells in the two-level grid directory.
+ * Local cell index: (i % BLOCK_SIDE) + (j % BLOCK_SIDE) * BLOCK_SIDE.
+ */
+struct GridBlock {
+    static const int BLOCK_SIDE = 16;
+    static const int BLOCK_CELLS = BLOCK_SIDE * BLOCK_SIDE;
+    /** @brief The position of each cell's partition in the index's 'partitions' vector (-1 for empty cells). */
+    int32_t cellSlots[BLOCK_CELLS];
+    /** @brief Occupancy bitset of the cells (by local cell index). */
+    uint64_t occupancy[BLOCK_CELLS / 64];
+
+    GridBlock() {
+        std::fill(cellSlots, cellSlots + BLOCK_CELLS, -1);
+        std::fill(occupancy, occupancy + BLOCK_CELLS / 64, 0);
+    }
 };
 
 /** @brief Holds all uniform grid index information.
  * @param partitions A vector containing each individual non-empty partition.
- * @param partitionMap A map that holds the positions of each partition (by ID) in the 'partitions' vector.
+ * @param blockSlots, blocks The two-level directory: the top level holds the position of each block of cells 
+ * in 'blocks' (-1 for empty blocks), each block holds the position of its cells' partitions in 'partitions'. 
+ * @param blockOccupancy Occupancy bitset of the top level blocks.
+ * @note The directory is sized for the configured partitions per dimension on the first insertion.
  */
 struct UniformGridIndex {
     std::vector<Partition> partitions;
-    std::unordered_map<int, size_t> partitionMap;
+    int partitionsPerDim = 0;
+    int blocksPerDim = 0;
+    std::vector<int32_t> blockSlots;
+    std::vector<uint64_t> blockOccupancy;
+    std::vector<GridBlock> blocks;
 private:
     /** @brief Compares to Shapes by MBR bottom-left point y. */
     static bool compareByY(const Shape* a, const Shape* b) {
         return a->mbr.pMin.y < b->mbr.pMin.y;
     }
+    /** @brief Sizes the (empty) directory for the configured partitions per dimension, if not already sized. */
+    void initDirectory();
+    /** @brief Returns the position of the partition in 'partitions' (-1 if it does not exist). */
+    inline int32_t getPartitionSlot(int partitionID) {
+        if (partitionsPerDim == 0) {
+            return -1;
+        }
+        int i = partitionID % partitionsPerDim;
+        int j = partitionID / partitionsPerDim;
+        int32_t blockSlot = blockSlots[(i / GridBlock::BLOCK_SIDE) + (j / GridBlock::BLOCK_SIDE) * blocksPerDim];
+        if (blockSlot < 0) {
+            return -1;
+        }
+        return blocks[blockSlot].cellSlots[(i % GridBlock::BLOCK_SIDE) + (j % GridBlock::BLOCK_SIDE) * GridBlock::BLOCK_SIDE];
+    }
 public:
     /** @brief Returns or creates a new partition with the given ID. */
     Partition* getOrCreatePartition(int partitionID);
+    /** @brief Adds an object ref to all partitions (grid cells or quadtree leaves) of its cell range. */
+    DB_STATUS addObject(Shape* objectRef);
     /** 
-    @brief Adds an object ref to a partition with partitionID
+    @brief Adds an object ref to a partition with partitionID, in its two-layer class for that partition.
      * @param[in] partitionID The partition's ID to add the object to.
      * @param[out] objectRef The returned object reference.
      */
@@ -1585,8 +1810,60 @@ public:
     @brief Returns the partition reference to this partition ID
      */
     Partition* getPartition(int partitionID);
+    /**
+    @brief Returns the pairs of partitions (this, other) of the cells that are non-empty in both indexes.
+     * The index with the fewer non-empty partitions drives: if it has fewer partitions than there are occupancy 
+     * words in the top level of the directory, its partitions are probed in the other index's directory.
+     * Otherwise the occupancy bitsets of the two directories are intersected.
+     * @return DBERR_INVALID_PARAMETER if the indexes have different grids.
+     */
+    DB_STATUS getCommonPartitions(UniformGridIndex &other, std::vector<std::pair<Partition*, Partition*>> &commonPartitions);
+    /** @brief Sorts the contents of each partition (per class) by MBR bottom-left y, for the plane sweep join. */
+    void sortPartitions();
+    /** @brief Removes all partitions and empties the directory. */
+    void clear();
+};
+
+/** @brief A node of a packed R-tree. Leaves hold a range of the tree's entries, internal nodes a range of its nodes. */
+struct RTreeNode {
+    MBR mbr;
+    int32_t first;
+    int32_t count;
+    bool leaf;
+};
+
+/** @brief Holds a packed (STR bulk-loaded) R-tree over a dataset's objects.
+ * @param nodes The nodes level by level, from the leaves up to the root (the last node).
+ * @param entries The object references, in leaf order.
+ * @param height The number of levels (0 for an empty tree).
+ */
+struct RTreeIndex {
+    std::vector<RTreeNode> nodes;
+    std::vector<Shape*> entries;
+    int height = 0;
+
+    bool isBuilt() {
+        return !nodes.empty();
+    }
+    RTreeNode* getRoot() {
+        return &nodes.back();
+    }
+    /** @brief Removes all nodes and entries. */
+    void clear();
 };
 
+/** @brief The APRIL approximations of a dataset's areal objects (by object ID) and the grid that they were built on. */
+struct AprilIndex {
+    /** @brief The order of the grid (2^order x 2^order cells), 0 if not built. */
+    int order = 0;
+    double xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+    std::unordered_map<size_t, AprilData> objects;
+
+    /** @brief Returns true if the approximations are built on the given grid. */
+    bool isBuiltFor(int order, DataspaceMetadata &dataspace) {
+        return this->order == order && xMin == dataspace.xMinGlobal && yMin == dataspace.yMinGlobal && xMax == dataspace.xMaxGlobal && yMax == dataspace.yMaxGlobal;
+    }
+};
 
 /**
  * @brief All dataset related information.
@@ -1610,6 +1887,12 @@ struct Dataset{
     std::vector<size_t> objectIDs;
     std::unordered_map<size_t, Shape> objects;
     UniformGridIndex uniformGridIndex;
+    // R-tree index only
+    RTreeIndex rtreeIndex;
+    // materializes the geometries of lazy shapes (lazy mode only)
+    std::shared_ptr<GeometryCache> geometryCache;
+    // APRIL intermediate filter only
+    AprilIndex aprilIndex;
 
     Dataset(){}
     Dataset(DatasetStatement &stmt);
@@ -1630,18 +1913,80 @@ struct Dataset{
 };
 
 
+/**
+@brief Interned entity names. Each distinct name is stored once in an arena and gets a compact 32-bit ID 
+ * with a stable string view. Interning is thread-safe. Lookups by ID are lock-free, so they must not run 
+ * concurrently with interning names that are not in the pool yet.
+ */
+struct NamePool {
+private:
+    static const size_t BLOCK_SIZE = 1 << 20;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockUsed = BLOCK_SIZE;
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, uint32_t> nameIDs;
+public:
+    /** @brief Returns the ID of the given name, adding it to the pool if needed. */
+    uint32_t intern(std::string_view name);
+
+    /** @brief Returns the name with the given ID. */
+    inline std::string_view get(uint32_t nameID) const {
+        return names[nameID];
+    }
+
+    size_t size();
+    void clear();
+};
+
+/**
+@brief Names interned by a single thread (no locking), e.g. the names of one loader chunk. 
+ * IDs are local and follow the order of first occurrence; they are mapped to NamePool IDs once all 
+ * threads are done.
+ */
+struct LocalNamePool {
+private:
+    // a deque, so that the views of the map stay valid as names are added
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, uint32_t> nameIDs;
+public:
+    /** @brief Returns the local ID of the given name, adding it if needed. */
+    inline uint32_t intern(std::string_view name) {
+        auto it = nameIDs.find(name);
+        if (it != nameIDs.end()) {
+            return it->second;
+        }
+        uint32_t nameID = names.size();
+        names.emplace_back(name);
+        nameIDs.emplace(names.back(), nameID);
+        return nameID;
+    }
+
+    inline std::string_view get(uint32_t nameID) const {
+        return names[nameID];
+    }
+
+    inline uint32_t size() const {
+        return names.size();
+    }
+};
+
 /** @brief Holds the dataset(s) related metadata in the configuration.
  */
 struct DatasetMetadata {
 private:
     Dataset* R;
     Dataset* S;
+    /** @brief All S datasets that R is joined with (S is the first one). */
+    std::vector<Dataset*> datasetsS;
     int numberOfDatasets;
     bool selfJoin = false;
 
 public:
     std::unordered_map<std::string,Dataset> datasets;
     DataspaceMetadata dataspaceMetadata;
+    // the entity names of all loaded datasets (shared, so that equal names get the same ID across datasets)
+    NamePool namePool;
     
     Dataset* getDatasetByNickname(std::string &nickname);
 
@@ -1653,14 +1998,24 @@ public:
 
     Dataset* getDatasetS();
 
+    /** @brief Returns all S datasets of the join (more than one in a multi-way join). */
+    std::vector<Dataset*>& getDatasetsS();
+
     Dataset* getDatasetByIdx(DatasetIndex datasetIndex);
 
     /**
-    @brief adds a Dataset to the configuration's dataset metadata
+    @brief adds a Dataset to the configuration's dataset metadata. Each added S dataset is appended to the S datasets.
      * @warning it has to be an empty dataset BUT its nickname needs to be set
      */
     DB_STATUS addDataset(DatasetIndex datasetIdx, Dataset &dataset);
 
+    /** @brief Sets the datasets R and S to join (already added datasets, batch mode). */
+    void setJoinDatasets(Dataset* R, Dataset* S);
+
+    /** @brief Removes the dataset with the given key, releasing its objects and index. */
+    void removeDataset(std::string &key);
+
+    /** @brief Sets the global dataspace to the bounds that enclose R and all S datasets, and sets it as their bounds. */
     void updateDataspace();
 
     void setSelfJoin(bool val);
@@ -1672,7 +2027,32 @@ struct DirectoryPaths {
 };
 
 struct IndexConfig {
+    /** @brief The space partitioning of the index. */
+    IndexType indexType = IT_UNIFORM_GRID;
+    /** @brief Uniform grid: the partitions per dimension. Quadtree: set to 2^depth when the tree is built. R-tree: unused. */
     int partitionsPerDim = 10000;
+    /** @brief Quadtree: a node is split while more objects (of all joined datasets) than this intersect it. */
+    size_t leafCapacity = 128;
+    /** @brief R-tree: the maximum number of entries (leaves) or children (internal nodes) of a node. */
+    size_t nodeCapacity = 16;
+    /** @brief If set, the dataspace bounds are read from/stored in a sidecar file next to each dataset file. */
+    bool useBoundsSidecar = false;
+    /** @brief If set, the loaded and indexed datasets are saved to this index snapshot file. */
+    std::string saveIndexPath = "";
+    /** @brief If set, the datasets are loaded from this index snapshot file (if valid) instead of being built. */
+    std::string loadIndexPath = "";
+    /** @brief If set, only the MBR, name, centroid and file offset of each object are kept in memory (TSV/WKT datasets). 
+     * Geometries are parsed again on demand for refinement and cached. */
+    bool lazyGeometries = false;
+    /** @brief Memory cap of each dataset's geometry cache in bytes (0: unlimited). */
+    size_t geometryCacheBytes = 0;
+    /** @brief How the candidate pairs are refined (full DE-9IM matrix, targeted predicates, or both cross-checked). */
+    RelateMode relateMode = RM_MATRIX;
+    /** @brief If set, candidate pairs of areal objects go through the APRIL intermediate filter before refinement, 
+     * on a grid of 2^aprilOrder x 2^aprilOrder cells over the global dataspace (0: disabled). */
+    int aprilOrder = 0;
+    /** @brief APRIL only: if set, the approximations of each dataset are read from/stored in this directory. */
+    std::string aprilDirectory = "";
 };
 
 /** @brief Parallel buffered disk writer for the relations texts */
@@ -1682,11 +2062,12 @@ private:
     size_t buffer_limit = 8192;    // in bytes (be careful of string::max_size)
     std::ofstream output;
     DocumentType docType = DOC_SENTENCES;
-    // for paragraph document type
-    std::unordered_map<std::string, std::string> entityRelationMap;
+    // for paragraph document type: per thread, the text of each entity (by name ID)
+    std::vector<std::unordered_map<uint32_t, std::string>> entityRelationMaps;
 public:
     DiskWriter(int numThreads) {
         buffers.resize(numThreads);
+        entityRelationMaps.resize(numThreads);
     }
     void addString(std::string &str, int tid);
     DB_STATUS writeBuffers();
@@ -1700,7 +2081,10 @@ public:
     void setDocumentType(DocumentType docType);
     DocumentType getDocumentType();
 
-    void appendTextForEntity(std::string entityKey, std::string text);
+    /** @brief Appends text to the paragraph of the entity with the given name ID (in the thread's own map). */
+    inline void appendTextForEntity(int tid, uint32_t nameID, const std::string &text) {
+        entityRelationMaps[tid][nameID] += text;
+    }
     
 };
 
@@ -1715,6 +2099,8 @@ public:
     DirectoryPaths dirPaths;
     IndexConfig indexConfig;
     DiskWriter diskWriter = DiskWriter(NUM_THREADS);
+    /** @brief Batch mode (-j): the jobs of the job file, in order. Empty otherwise. */
+    std::vector<JobStatement> jobs;
 
     void setNumThreads(int numThreads) {
         NUM_THREADS = numThreads;
@@ -1728,4 +2114,8 @@ public:
 
 extern Config g_config;
 
+inline std::string_view Shape::getName() const {
+    return g_config.datasetMetadata.namePool.get(nameID);
+}
+
 #endif
\ No newline at end of file
@@ -63,6 +63,7 @@ typedef enum DB_STATUS {
     DBERR_INVALID_PARTITION = DBBASE + 1010,
     DBERR_FILE_WRITE = DBBASE + 1011,
     DBERR_INVALID_DOC_TYPE = DBBASE + 1012,
+    DBERR_INVALID_WKT = DBBASE + 1013,
 } DB_STATUS;
 
 /** @enum FileFormat @brief Data file types. */
@@ -108,6 +109,15 @@ enum CardinalDirection {
     CD_NONE = 777,
 };
 
+/** 
+@brief A DE-9IM matrix encoded in its 9 low bits: bit i is set if cell i of the matrix (row-major: II, IB, IE, BI, BB, BE, 
+ * EI, EB, EE) is not empty, i.e. not 'F'. The masks of the refinement only test cells for empty/non-empty, so this is exact for them.
+ */
+typedef uint16_t De9imCode;
+
+/** @brief Returned instead of a De9imCode for the geometry type pairs that are not supported (outside the 9 low bits). */
+const De9imCode DE9IM_CODE_INVALID = 1 << 9;
+
 enum TopologyRelation {
     TR_DISJOINT,
     TR_EQUAL,
@@ -120,6 +130,47 @@ enum TopologyRelation {
     TR_INVALID = 777,
 };
 
+/** 
+@enum TwoLayerClass @brief Two-layer index classes of an object in a partition, by whether its MBR starts 
+ * inside the partition in x and/or y:
+ * A: in x and y, B: only in y, C: only in x, D: in neither.
+ */
+enum TwoLayerClass {
+    CLASS_A,
+    CLASS_B,
+    CLASS_C,
+    CLASS_D,
+};
+
+/** @enum IndexType @brief Space partitioning of the index. */
+enum IndexType {
+    IT_INVALID,
+    IT_UNIFORM_GRID,
+    IT_QUADTREE,
+    IT_RTREE,
+};
+
+/** 
+@enum RelateMode @brief How the topological relation of a candidate pair is refined:
+ * MATRIX: the full DE-9IM matrix is computed and classified.
+ * PREDICATES: only the masks that the MBR relation case needs are tested, each stopping as soon as it is decided.
+ * CHECK: both, cross-checking the predicates against the matrix.
+ */
+enum RelateMode {
+    RM_INVALID,
+    RM_MATRIX,
+    RM_PREDICATES,
+    RM_CHECK,
+};
+
+/** @enum PointLocation @brief The location of a point in a geometry (undecided if it is not computed for the geometry types). */
+enum PointLocation {
+    PL_INTERIOR,
+    PL_BOUNDARY,
+    PL_EXTERIOR,
+    PL_UNDECIDED,
+};
+
 enum DocumentType {
     DOC_SENTENCES,
     DOC_PARAGRAPHS,
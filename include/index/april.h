@@ -0,0 +1,68 @@
+#ifndef INDEX_APRIL_H
+#define INDEX_APRIL_H
+
+#include <fstream>
+#include <cstdint>
+
+#include "def.h"
+#include "containers.h"
+#include "cache.h"
+#include "index/snapshot.h"
+
+namespace april
+{
+    /**
+    @brief APRIL (Approximating Polygons as Raster Interval Lists) intermediate filter.
+     *
+     * The global dataspace is divided into a grid of 2^order x 2^order cells, numbered along the Hilbert curve.
+     * Each areal object is rasterized into the intervals of the cells that it intersects (ALL) and of the cells
+     * that lie in its interior (FULL), see AprilData. A cell belongs to ALL if the object's boundary passes within
+     * a tiny margin of it, or if the cell is in the object's interior. It belongs to FULL if it is in the interior
+     * and the boundary does not pass within the margin, so both approximations are conservative.
+     *
+     * For a candidate pair, the intermediate filter merge-joins the interval lists to decide the relation:
+     *  - no common ALL cells: disjoint
+     *  - R's ALL cells inside S's FULL cells: R inside S (and symmetrically, R contains S)
+     *  - common ALL/FULL cells: the interiors intersect, so for a pair where R is not covered by S (an ALL cell
+     *    of R that is not an ALL cell of S) and S is not covered by R, as allowed by the MBR relation case, they intersect.
+     * The rest of the pairs are refined.
+     *
+     * Persistence (optional, see IndexConfig::aprilDirectory): one file per dataset, '<dataset file name>_<path hash>_<order>.april', with
+     *  - Header and the dataset's source key (see snapshot::getDatasetKey)
+     *  - per areal object: uint64_t recID, uint64_t allCount, uint64_t fullCount,
+     *    uint32_t[allCount] ALL intervals, uint32_t[fullCount] FULL intervals
+     * It is rebuilt if the dataset file, the order or the global dataspace changed.
+     */
+
+    /** @brief The maximum order of the grid (the Hilbert cell numbers must fit 32 bits). */
+    const int MAX_ORDER = 16;
+
+    const char APRIL_MAGIC[8] = {'S', 'P', 'T', 'X', 'A', 'P', 'R', '\0'};
+    const uint32_t APRIL_VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        int32_t order;
+        double xMinGlobal, yMinGlobal, xMaxGlobal, yMaxGlobal;
+        uint64_t keyLength;
+        uint64_t objectCount;
+    };
+
+    /**
+    @brief Builds the APRIL approximations of the dataset's areal objects for the configured order and the global dataspace
+     * (or loads them from the APRIL directory, if they are stored there for the same ones), and links them to the objects.
+     * Nothing is done if they are already built on the same grid.
+     * @warning The global dataspace bounds must be set.
+     */
+    DB_STATUS build(Dataset* dataset);
+
+    /**
+    @brief The intermediate filter: decides the topological relation of the candidate pair from the objects' approximations,
+     * if possible, for the MBR relation case of the pair (the relation is the one the refinement would find).
+     * @return false if the pair is undecided (or an approximation is missing), so it has to be refined.
+     */
+    bool filter(const AprilData* aprilR, const AprilData* aprilS, MBRRelationCase mbrRelationCase, TopologyRelation &relation);
+}
+
+#endif
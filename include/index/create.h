@@ -2,16 +2,37 @@
 #define INDEX_CREATE_H
 
 #include <fstream>
+#include <iomanip>
 
 #include "def.h"
 #include "containers.h"
+#include "loader.h"
+#include "index/snapshot.h"
+#include "index/quadtree.h"
+#include "index/rtree.h"
+#include "index/april.h"
 
 namespace uniform_grid
 {
     int getPartitionID(int i, int j, int partitionsPerDim);
-    
+
     DB_STATUS create();
 
+    /**
+    @brief Loads the objects of the dataset and calculates its own dataspace bounds, without indexing them (batch mode).
+     * @note See reindex() for indexing the objects.
+     */
+    DB_STATUS loadObjects(Dataset* dataset);
+
+    /**
+    @brief (Re)builds the index of a dataset whose objects are loaded, 
+     * for the current global dataspace bounds and partitions per dimension (batch mode).
+     */
+    DB_STATUS reindex(Dataset* dataset);
+
+    /** @brief Quadtree index only: builds the tree from the MBRs of the loaded objects of R and S (batch mode). */
+    DB_STATUS buildQuadtree(Dataset* R, Dataset* S);
+
 }
 
 #endif
\ No newline at end of file
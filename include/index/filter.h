@@ -9,13 +9,19 @@ namespace uniform_grid
 {
     namespace sentences
     {
-        DB_STATUS evaluate(Dataset* R, Dataset* S);
+        DB_STATUS evaluate(Dataset* R, std::vector<Dataset*> &datasetsS);
     }
 
     namespace paragraphs
     {
-        DB_STATUS evaluate(Dataset* R, Dataset* S);
+        DB_STATUS evaluate(Dataset* R, std::vector<Dataset*> &datasetsS);
     }
+
+    /** @brief Evaluates the join between R and S, generating the configured document type. */
+    DB_STATUS evaluate(Dataset* R, Dataset* S);
+
+    /** @brief Evaluates the multi-way join of R with each of the S datasets in a single pass over R's partitions. */
+    DB_STATUS evaluate(Dataset* R, std::vector<Dataset*> &datasetsS);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef INDEX_QUADTREE_H
+#define INDEX_QUADTREE_H
+
+#include <cstdint>
+
+#include "def.h"
+#include "containers.h"
+
+namespace quadtree
+{
+    /**
+    @brief Adaptive partitioning of the global dataspace (shared by R and S).
+     *
+     * A node is split into four quadrants while more than leafCapacity objects (of both datasets)
+     * intersect it, up to MAX_DEPTH levels. All node boundaries are aligned to a grid of
+     * 2^MAX_DEPTH x 2^MAX_DEPTH cells, so each leaf is a square block of cells of the 2^depth x 2^depth
+     * grid (depth: the deepest leaf level). A leaf's partition ID is the grid ID of its bottom-left cell
+     * in that grid, so the leaves plug into the uniform grid index and its evaluation as regular partitions
+     * (with partitionsPerDim = 2^depth).
+     */
+
+    /** @brief The maximum depth of the tree (2^(2*MAX_DEPTH) must fit the int partition IDs). */
+    const int MAX_DEPTH = 15;
+
+    /**
+    @brief Builds the tree from the MBRs of the objects of both datasets and sets the configured
+     * partitions per dimension to 2^depth.
+     * @warning The global dataspace bounds must be set.
+     */
+    DB_STATUS build(std::vector<MBR*> &mbrs);
+
+    /** @brief Calculates the range of cells of the 2^depth grid that the MBR intersects. */
+    void getCellRange(MBR &mbr, int &minCellX, int &minCellY, int &maxCellX, int &maxCellY);
+
+    /** @brief Calculates the IDs of the leaves that intersect with the range of cells of the 2^depth grid. */
+    DB_STATUS getPartitionsForCellRange(int minCellX, int minCellY, int maxCellX, int maxCellY, std::vector<int> &partitionIDs);
+}
+
+#endif
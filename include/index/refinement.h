@@ -2,65 +2,111 @@
 #define INDEX_REFINEMENT_H
 
 #include "containers.h"
+#include "cache.h"
+#include "index/april.h"
 
 namespace refinement
 {
     /**
      * TOPOLOGY RELATION DE-9IM CODES
     */
-    static char insideCode[] = "T*F**F***";
+    static constexpr char insideCode[] = "T*F**F***";
     // char trueInsideCode[] = "T*F*FF***";
-    static char coveredbyCode1[] = "T*F**F***";
-    static char coveredbyCode2[] = "*TF**F***";
-    static char coveredbyCode3[] = "**FT*F***";
-    static char coveredbyCode4[] = "**F*TF***";
-    static char containsCode[] = "T*****FF*";
-    static char coversCode1[] = "T*****FF*";
-    static char coversCode2[] = "*T****FF*";
-    static char coversCode3[] = "***T**FF*";
-    static char coversCode4[] = "****T*FF*";
-    static char meetCode1[] = "FT*******"; 
-    static char meetCode2[] = "F**T*****"; 
-    static char meetCode3[] = "F***T****"; 
-    static char equalCode[] = "T*F**FFF*"; 
-    static char disjointCode[] = "FF*FF****";
-    static char intersectCode1[] = "T********";
-    static char intersectCode2[] = "*T*******";
-    static char intersectCode3[] = "***T*****";
-    static char intersectCode4[] = "****T****";
+    static constexpr char coveredbyCode1[] = "T*F**F***";
+    static constexpr char coveredbyCode2[] = "*TF**F***";
+    static constexpr char coveredbyCode3[] = "**FT*F***";
+    static constexpr char coveredbyCode4[] = "**F*TF***";
+    static constexpr char containsCode[] = "T*****FF*";
+    static constexpr char coversCode1[] = "T*****FF*";
+    static constexpr char coversCode2[] = "*T****FF*";
+    static constexpr char coversCode3[] = "***T**FF*";
+    static constexpr char coversCode4[] = "****T*FF*";
+    static constexpr char meetCode1[] = "FT*******"; 
+    static constexpr char meetCode2[] = "F**T*****"; 
+    static constexpr char meetCode3[] = "F***T****"; 
+    static constexpr char equalCode[] = "T*F**FFF*"; 
+    static constexpr char disjointCode[] = "FF*FF****";
+    static constexpr char intersectCode1[] = "T********";
+    static constexpr char intersectCode2[] = "*T*******";
+    static constexpr char intersectCode3[] = "***T*****";
+    static constexpr char intersectCode4[] = "****T****";
+
+    /**
+    @brief A topological mask compiled into bitmasks over a De9imCode: 'care' holds the cells that the mask 
+     * constrains ('T' or 'F'), 'match' the ones of them that must be non-empty ('T').
+     */
+    struct De9imMask {
+        De9imCode care;
+        De9imCode match;
+
+        /** @brief Returns true if the encoded matrix matches the mask. */
+        constexpr bool matches(De9imCode code) const {
+            return ((code ^ match) & care) == 0;
+        }
+    };
+
+    /** @brief Compiles a 9 character mask code ('T', 'F' or '*' per cell) into a De9imMask. */
+    constexpr De9imMask compileMask(const char* maskCode) {
+        De9imMask mask = {0, 0};
+        for (int i=0; i<9; i++) {
+            if (maskCode[i] == 'T' || maskCode[i] == 'F') {
+                mask.care |= 1 << i;
+            }
+            if (maskCode[i] == 'T') {
+                mask.match |= 1 << i;
+            }
+        }
+        return mask;
+    }
+
+    /** @brief Returns true if the encoded matrix matches any of the masks. */
+    template <size_t N>
+    constexpr bool matchesAny(De9imCode code, const De9imMask (&masks)[N]) {
+        for (size_t i=0; i<N; i++) {
+            if (masks[i].matches(code)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
     //define topological masks for refinement
     // a inside b
-    static boost::geometry::de9im::mask insideMask(insideCode); 
+    static constexpr De9imMask insideMask = compileMask(insideCode); 
     // a contains b
-    static boost::geometry::de9im::mask containsMask(containsCode); 
+    static constexpr De9imMask containsMask = compileMask(containsCode); 
     // a covered by b
-    static std::vector<boost::geometry::de9im::mask> coveredByMaskList = {
-                    boost::geometry::de9im::mask(coveredbyCode1),
-                    boost::geometry::de9im::mask(coveredbyCode2),
-                    boost::geometry::de9im::mask(coveredbyCode3),
-                    boost::geometry::de9im::mask(coveredbyCode4)};
+    static constexpr De9imMask coveredByMaskList[] = {
+                    compileMask(coveredbyCode1),
+                    compileMask(coveredbyCode2),
+                    compileMask(coveredbyCode3),
+                    compileMask(coveredbyCode4)};
     // a covers b
-    static std::vector<boost::geometry::de9im::mask> coversMaskList = {
-                    boost::geometry::de9im::mask(coversCode1),
-                    boost::geometry::de9im::mask(coversCode2),
-                    boost::geometry::de9im::mask(coversCode3),
-                    boost::geometry::de9im::mask(coversCode4)};
+    static constexpr De9imMask coversMaskList[] = {
+                    compileMask(coversCode1),
+                    compileMask(coversCode2),
+                    compileMask(coversCode3),
+                    compileMask(coversCode4)};
     // a and b meet
-    static boost::geometry::de9im::mask meetMask1(meetCode1); 
-    static boost::geometry::de9im::mask meetMask2(meetCode2); 
-    static boost::geometry::de9im::mask meetMask3(meetCode3); 
+    static constexpr De9imMask meetMaskList[] = {
+                    compileMask(meetCode1),
+                    compileMask(meetCode2),
+                    compileMask(meetCode3)};
     // a and b are equal
-    static boost::geometry::de9im::mask equalMask(equalCode); 
+    static constexpr De9imMask equalMask = compileMask(equalCode); 
     // a and b are disjoint
-    static boost::geometry::de9im::mask disjointMask(disjointCode); 
+    static constexpr De9imMask disjointMask = compileMask(disjointCode); 
     // a overlaps b
-    static std::vector<boost::geometry::de9im::mask> overlapMaskList = {
-                    boost::geometry::de9im::mask(intersectCode1),
-                    boost::geometry::de9im::mask(intersectCode2),
-                    boost::geometry::de9im::mask(intersectCode3),
-                    boost::geometry::de9im::mask(intersectCode4)};
+    static constexpr De9imMask overlapMaskList[] = {
+                    compileMask(intersectCode1),
+                    compileMask(intersectCode2),
+                    compileMask(intersectCode3),
+                    compileMask(intersectCode4)};
+
 
+    /** @brief A mask code compiled into a boost static mask, for boost's relate (see Shape::relate). Combine several with ||. */
+    template <const char* maskCode>
+    using StaticMask = boost::geometry::de9im::static_mask<maskCode[0], maskCode[1], maskCode[2], maskCode[3], maskCode[4], maskCode[5], maskCode[6], maskCode[7], maskCode[8]>;
 
     namespace sentences
     {
@@ -69,11 +115,17 @@ namespace refinement
 
     namespace paragraphs
     {
-        DB_STATUS computeRelations(Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase, DocumentType docType);
+        DB_STATUS computeRelations(int tid, Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase, DocumentType docType);
     }
 
     DB_STATUS computeCardinalDirectionBetweenShapes(Shape* objR, Shape* objS, CardinalDirection &direction);
 
+    /** @brief Resets the refinement statistics (time and refined pairs of each relate mode, per thread). */
+    void resetStatistics();
+
+    /** @brief Logs the refinement statistics of the configured relate mode. */
+    void printStatistics();
+
 }
 
 
@@ -0,0 +1,29 @@
+#ifndef INDEX_RTREE_H
+#define INDEX_RTREE_H
+
+#include "def.h"
+#include "containers.h"
+
+namespace rtree
+{
+    /**
+    @brief Packed R-tree index: each dataset is bulk-loaded into its own tree with Sort-Tile-Recursive (STR)
+     * packing, independently of the global dataspace and of the other dataset. Every object is stored once,
+     * no matter how large it is. R and S are joined by a synchronized traversal of their trees, which reports
+     * each pair of objects with intersecting MBRs exactly once.
+     */
+
+    /** @brief Called for each pair of objects (r, s) with intersecting MBRs, by thread tid. */
+    typedef DB_STATUS (*PairFunction)(int tid, Shape* objR, Shape* objS);
+
+    /** @brief (Re)builds the R-tree of the dataset from its loaded objects, with the configured node capacity. */
+    DB_STATUS build(Dataset* dataset);
+
+    /**
+    @brief Joins the R-trees of R and S in parallel, calling pairFunction for each pair of objects with
+     * intersecting MBRs (including touching ones), the same candidate pairs as the grid and quadtree joins.
+     */
+    DB_STATUS join(Dataset* R, Dataset* S, PairFunction pairFunction);
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef INDEX_SNAPSHOT_H
+#define INDEX_SNAPSHOT_H
+
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+#include "def.h"
+#include "containers.h"
+#include "binary.h"
+
+namespace uniform_grid
+{
+    /**
+    @brief Persistent snapshots of the loaded and indexed datasets R and S.
+     *
+     * A snapshot holds, for each dataset, its objects in the binary dataset layout (geometries, MBRs, names) 
+     * and the grid cell range of every object, for the snapshot's partitionsPerDim and global dataspace bounds.
+     * It is tied to the state of the source dataset files (path, size, modification time, column setup) 
+     * and its payload is protected by a checksum. Snapshots are memory-mapped when loaded.
+     *
+     * Layout (all sections 8-byte aligned):
+     *  - Header
+     *  - per dataset (R, S): DatasetHeader, source key, binary objects, 
+     *    int32_t[objectCount * 4] cell ranges (minCellX, minCellY, maxCellX, maxCellY)
+     *  - in self-joins S aliases R, so only R's section is stored (datasetCount = 1)
+     */
+    namespace snapshot
+    {
+        const char SNAPSHOT_MAGIC[8] = {'S', 'P', 'T', 'X', 'I', 'D', 'X', '\0'};
+        const uint32_t SNAPSHOT_VERSION = 2;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t datasetCount;
+            uint64_t checksum;
+            int64_t partitionsPerDim;
+            double xMinGlobal, yMinGlobal, xMaxGlobal, yMaxGlobal;
+        };
+
+        struct DatasetHeader {
+            uint64_t keyLength;
+            uint64_t objectsBytes;
+            uint64_t objectCount;
+        };
+
+        /** 
+        @brief Returns the key that ties a snapshot to the current state of the dataset's file and setup. 
+         * @return An empty key if the dataset file cannot be read; it never matches a stored key.
+         */
+        std::string getDatasetKey(Dataset* dataset);
+
+        /** @brief Writes a snapshot of the (indexed) datasets R and S to the given path. */
+        DB_STATUS save(std::string &path);
+
+        /**
+        @brief Loads and indexes the datasets R and S from the snapshot at the given path, if it is valid.
+         * @param[out] loaded Set to false if the snapshot is missing, outdated or corrupt (nothing is loaded then),
+         * so the index must be built from the dataset files.
+         */
+        DB_STATUS load(std::string &path, bool &loaded);
+    }
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "def.h"
+#include "containers.h"
+#include "binary.h"
+#include "wkt.h"
+#include "cache.h"
+
+/** @brief Dataset file loading. Objects are parsed in parallel, one list per thread (chunk), without being indexed. */
+namespace loader
+{
+    /**
+    @brief Parses one data line of a TSV/WKT dataset into the given (empty) object.
+     * @return DBERR_INVALID_GEOMETRY if the line holds a geometry that should be ignored, 
+     * DBERR_INVALID_WKT if its WKT is malformed.
+     * @param names The pool that the object's name is interned into. If null, the name is not read and 
+     * the object's name ID is left for the caller to set.
+     */
+    DB_STATUS parseLine(Dataset* dataset, std::string_view line, size_t recID, Shape &object, LocalNamePool* names);
+
+    /**
+    @brief Loads the dataset's objects with their MBRs set, based on the dataset's file format. 
+     * Record IDs are the objects' line numbers in the original (text) dataset file and the chunks are in file order.
+     * @param[out] chunkObjects The loaded objects, one list per chunk.
+     */
+    DB_STATUS loadDataset(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#include <getopt.h>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/exceptions.hpp>
@@ -8,10 +9,14 @@
 #include "containers.h"
 #include "utils.h"
 #include "config.h"
+#include "index/april.h"
 
 namespace parse
 {
     DB_STATUS parseArguments(int argc, char *argv[]);
+
+    /** @brief Loads (and verifies) the statement of a single dataset from datasets.ini, by its nickname. */
+    DB_STATUS parseDatasetStatement(std::string nickname, DatasetStatement &datasetStmt);
 }
 
 #endif
\ No newline at end of file
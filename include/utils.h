@@ -2,6 +2,9 @@
 #define UTILS_H
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -77,6 +80,14 @@ namespace mapping
     std::string documentTypeIntToStr(DocumentType docType);
 
     DocumentType documentTypeTextToInt(std::string str);
+
+    std::string indexTypeIntToStr(IndexType indexType);
+
+    IndexType indexTypeTextToInt(std::string str);
+
+    std::string relateModeIntToStr(RelateMode relateMode);
+
+    RelateMode relateModeTextToInt(std::string str);
 }
 
 /**
@@ -89,23 +100,36 @@ bool verifyFilepath(std::string filePath);
 
 bool verifyDirectory(std::string directoryPath);
 
+/** @brief Read-only memory mapping of an entire file. 
+ * @warning The mapping is released only by an explicit call to unmap(). */
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+
+    /** @brief Opens and maps the file at the given path. Empty files are valid and have a null data pointer. */
+    DB_STATUS map(const std::string &filePath);
+    /** @brief Releases the mapping and closes the file descriptor. */
+    void unmap();
+};
+
 double convertDegreesToSquareKilometers(double areaInDegrees, double lat);
 
 namespace text_generator
 {   
     /** @brief Generates text based on the given cardinal direction and two entities. 
      * Semantics: entityNameR is 'direction' of entityNameS */
-    std::string generateDirectionalRelation(std::string &entityNameR, std::string &entityNameS, CardinalDirection direction);
+    std::string generateDirectionalRelation(std::string_view entityNameR, std::string_view entityNameS, CardinalDirection direction);
 
     /** @brief Generates text based on the given topological relation and two entities. 
      * Semantics: entityNameR 'relation text' entityNameS */
-    std::string generateTopologicalRelation(std::string &entityNameR, std::string &entityNameS, TopologyRelation relation);
+    std::string generateTopologicalRelation(std::string_view entityNameR, std::string_view entityNameS, TopologyRelation relation);
 
     /** @brief generate the combined topological relation between two entities, that includes: relation type, cardinal direction, and common are (if any)*/
-    std::string generateCombinedTopologicalRelation(std::string &entityNameR, std::string &entityNameS, TopologyRelation relation, CardinalDirection direction, std::string area);
+    std::string generateCombinedTopologicalRelation(std::string_view entityNameR, std::string_view entityNameS, TopologyRelation relation, CardinalDirection direction, std::string area);
 
 
-    std::string generateAreaInSqkm(std::string &entityNameR, std::string &entityNameS, double area);
+    std::string generateAreaInSqkm(std::string_view entityNameR, std::string_view entityNameS, double area);
 }
 
 /** @brief Returns the cardinal direction based on a linestring's angle (in degrees) */
@@ -117,9 +141,6 @@ CardinalDirection getOppositeCardinalDirection(CardinalDirection direction);
 /** @brief Returns the textual swap of the given topology relation. */
 TopologyRelation getSwappedTopologyRelation(TopologyRelation relation);
 
-/** @brief Splits the given string using the specified delimiter into the array */
-DB_STATUS splitString(std::string &input, char delimiter, std::vector<std::string> &tokens);
-
 namespace state
 {
     std::string stateFpToStateName(int stateFP);
@@ -0,0 +1,29 @@
+#ifndef WKT_H
+#define WKT_H
+
+#include <string_view>
+#include <charconv>
+
+#include "def.h"
+
+/** @brief Allocation-free WKT tokenizer that reads the geometry text straight into the boost geometries.
+ *
+ * Works on string views of the input (no copies, no streams) and parses coordinates with std::from_chars.
+ * Each ring/linestring is counted before it is read, so its capacity is reserved once.
+ * All parse methods return DBERR_INVALID_GEOMETRY if the text is tagged with a different (or unsupported) geometry type
+ * and DBERR_INVALID_WKT if it is malformed.
+ */
+namespace wkt
+{
+    /** @brief Returns the data type of the WKT text, based on its geometry tag (e.g. 'POLYGON').
+     * Returns DT_INVALID for unknown/unsupported tags. */
+    DataType getDataType(std::string_view wktText);
+
+    DB_STATUS parse(std::string_view wktText, bg_point_xy &geometry);
+    DB_STATUS parse(std::string_view wktText, bg_linestring &geometry);
+    DB_STATUS parse(std::string_view wktText, bg_rectangle &geometry);
+    DB_STATUS parse(std::string_view wktText, bg_polygon &geometry);
+    DB_STATUS parse(std::string_view wktText, bg_multi_polygon &geometry);
+}
+
+#endif
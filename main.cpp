@@ -2,6 +2,7 @@
 #include "include/parse.h"
 #include "include/index/create.h"
 #include "include/index/filter.h"
+#include "include/batch.h"
 
 
 int main(int argc, char *argv[]) {
@@ -15,6 +16,16 @@ int main(int argc, char *argv[]) {
         return ret;
     }
 
+    if (!g_config.jobs.empty()) {
+        // batch mode
+        ret = batch::run();
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Batch run failed.");
+            return ret;
+        }
+        return 0;
+    }
+
     // load data to index
     ret = uniform_grid::create();
     if (ret != DBERR_OK) {
@@ -23,10 +34,18 @@ int main(int argc, char *argv[]) {
     }
 
     logger::log_success("Dataset", g_config.datasetMetadata.getDatasetR()->nickname, "loaded", g_config.datasetMetadata.getDatasetR()->totalObjects,"objects");
-    logger::log_success("Dataset", g_config.datasetMetadata.getDatasetS()->nickname, "loaded", g_config.datasetMetadata.getDatasetS()->totalObjects,"objects");
+    if (!g_config.datasetMetadata.getSelfJoin()) {
+        for (Dataset* S : g_config.datasetMetadata.getDatasetsS()) {
+            logger::log_success("Dataset", S->nickname, "loaded", S->totalObjects,"objects");
+        }
+    }
     
     g_config.datasetMetadata.getDatasetR()->printPartitionStatistics();
-    g_config.datasetMetadata.getDatasetS()->printPartitionStatistics();
+    if (!g_config.datasetMetadata.getSelfJoin()) {
+        for (Dataset* S : g_config.datasetMetadata.getDatasetsS()) {
+            S->printPartitionStatistics();
+        }
+    }
     // g_config.datasetMetadata.getDatasetR()->printPartitionContents(383318);
     // g_config.datasetMetadata.getDatasetS()->printPartitionContents(383318);
 
@@ -34,27 +53,21 @@ int main(int argc, char *argv[]) {
 
     // evaluate
     timer = clock();
-    switch (g_config.diskWriter.getDocumentType()) {
-        case DOC_SENTENCES:
-            ret = uniform_grid::sentences::evaluate(g_config.datasetMetadata.getDatasetR(), g_config.datasetMetadata.getDatasetS());
-            if (ret != DBERR_OK) {
-                logger::log_error(ret, "Evaluation failed.");
-                return ret;
-            }
-            break;
-        case DOC_PARAGRAPHS:
-        case DOC_PARAGRAPHS_COMPRESSED:
-            ret = uniform_grid::paragraphs::evaluate(g_config.datasetMetadata.getDatasetR(), g_config.datasetMetadata.getDatasetS());
-            if (ret != DBERR_OK) {
-                logger::log_error(ret, "Evaluation failed.");
-                return ret;
-            }
-            break;
-        default:
-            logger::log_error(DBERR_INVALID_DOC_TYPE, "Invalid output document type, code:", g_config.diskWriter.getDocumentType());
-            break;
+    ret = uniform_grid::evaluate(g_config.datasetMetadata.getDatasetR(), g_config.datasetMetadata.getDatasetsS());
+    if (ret != DBERR_OK) {
+        return ret;
     }
     logger::log_success("Evaluation finished in", (clock()-timer) / (double)(CLOCKS_PER_SEC), "seconds");
+    if (g_config.datasetMetadata.getDatasetR()->geometryCache != nullptr) {
+        g_config.datasetMetadata.getDatasetR()->geometryCache->printStatistics();
+    }
+    if (!g_config.datasetMetadata.getSelfJoin()) {
+        for (Dataset* S : g_config.datasetMetadata.getDatasetsS()) {
+            if (S->geometryCache != nullptr) {
+                S->geometryCache->printStatistics();
+            }
+        }
+    }
 
     // print write buffers
     // g_config.diskWriter.printBufferSizes();
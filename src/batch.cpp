@@ -0,0 +1,178 @@
+#include "batch.h"
+
+namespace batch
+{
+    /** @brief The grid that a dataset's index was built for. */
+    struct IndexState {
+        int partitionsPerDim = -1;
+        double xMinGlobal, yMinGlobal, xMaxGlobal, yMaxGlobal;
+
+        bool operator==(const IndexState &other) const {
+            return partitionsPerDim == other.partitionsPerDim && xMinGlobal == other.xMinGlobal && yMinGlobal == other.yMinGlobal
+                && xMaxGlobal == other.xMaxGlobal && yMaxGlobal == other.yMaxGlobal;
+        }
+    };
+
+    /** @brief A dataset loaded in batch mode. */
+    struct LoadedDataset {
+        Dataset* dataset = nullptr;
+        // the dataset's own bounds (the Dataset's dataspace metadata is overwritten by the global one)
+        DataspaceMetadata bounds;
+        IndexState indexState;
+    };
+
+    /** @brief Returns the dataset of the statement, loading it if it is not loaded yet. */
+    static DB_STATUS getOrLoadDataset(DatasetStatement &stmt, std::unordered_map<std::string, LoadedDataset> &loaded, LoadedDataset* &loadedDataset) {
+        DB_STATUS ret = DBERR_OK;
+        auto it = loaded.find(stmt.key);
+        if (it != loaded.end()) {
+            loadedDataset = &it->second;
+            return ret;
+        }
+        Dataset dataset(stmt);
+        g_config.datasetMetadata.datasets[stmt.key] = dataset;
+        loadedDataset = &loaded[stmt.key];
+        loadedDataset->dataset = g_config.datasetMetadata.getDatasetByNickname(stmt.key);
+        clock_t timer = clock();
+        ret = uniform_grid::loadObjects(loadedDataset->dataset);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        loadedDataset->bounds = loadedDataset->dataset->dataspaceMetadata;
+        logger::log_success("Dataset", stmt.nickname, "loaded", loadedDataset->dataset->totalObjects, "objects in", (clock()-timer) / (double)(CLOCKS_PER_SEC), "seconds");
+        return ret;
+    }
+
+    /** @brief Indexes the dataset for the current grid, unless its index was already built for it. */
+    static DB_STATUS prepareIndex(LoadedDataset* loadedDataset) {
+        if (g_config.indexConfig.indexType == IT_RTREE) {
+            // the R-tree does not depend on the grid or the other dataset, it is built once
+            if (loadedDataset->dataset->rtreeIndex.isBuilt()) {
+                logger::log_success("Reusing the index of dataset", loadedDataset->dataset->nickname);
+                return DBERR_OK;
+            }
+            return rtree::build(loadedDataset->dataset);
+        }
+        IndexState state;
+        state.partitionsPerDim = g_config.indexConfig.partitionsPerDim;
+        state.xMinGlobal = g_config.datasetMetadata.dataspaceMetadata.xMinGlobal;
+        state.yMinGlobal = g_config.datasetMetadata.dataspaceMetadata.yMinGlobal;
+        state.xMaxGlobal = g_config.datasetMetadata.dataspaceMetadata.xMaxGlobal;
+        state.yMaxGlobal = g_config.datasetMetadata.dataspaceMetadata.yMaxGlobal;
+        if (g_config.indexConfig.indexType == IT_UNIFORM_GRID && loadedDataset->indexState == state) {
+            logger::log_success("Reusing the index of dataset", loadedDataset->dataset->nickname);
+            return DBERR_OK;
+        }
+        DB_STATUS ret = uniform_grid::reindex(loadedDataset->dataset);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        loadedDataset->indexState = state;
+        return ret;
+    }
+
+    static DB_STATUS runJob(JobStatement &job, std::unordered_map<std::string, LoadedDataset> &loaded) {
+        DB_STATUS ret = DBERR_OK;
+        LoadedDataset* R = nullptr;
+        LoadedDataset* S = nullptr;
+        ret = getOrLoadDataset(job.datasetR, loaded, R);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        ret = getOrLoadDataset(job.datasetS, loaded, S);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        g_config.datasetMetadata.setJoinDatasets(R->dataset, S->dataset);
+        g_config.datasetMetadata.setSelfJoin(R->dataset->path.compare(S->dataset->path) == 0);
+
+        // the global dataspace is the union of the two datasets' own bounds
+        g_config.datasetMetadata.dataspaceMetadata = DataspaceMetadata();
+        R->dataset->dataspaceMetadata = R->bounds;
+        S->dataset->dataspaceMetadata = S->bounds;
+        g_config.datasetMetadata.updateDataspace();
+        g_config.indexConfig.partitionsPerDim = job.partitionsPerDim;
+        if (g_config.indexConfig.indexType == IT_QUADTREE) {
+            // the tree depends on both datasets, so it is built (and the datasets are indexed) for each job
+            ret = uniform_grid::buildQuadtree(R->dataset, S->dataset);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
+
+        ret = prepareIndex(R);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        if (S != R) {
+            ret = prepareIndex(S);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
+        // the APRIL approximations are rebuilt if the global dataspace changed
+        ret = april::build(R->dataset);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        ret = april::build(S->dataset);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        R->dataset->printPartitionStatistics();
+        S->dataset->printPartitionStatistics();
+
+        // output
+        ret = g_config.diskWriter.openOutputFilestream(job.outputStmt.outputFilepath, job.outputStmt.append);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while opening output filestream.");
+            return ret;
+        }
+        g_config.diskWriter.setDocumentType(mapping::documentTypeTextToInt(job.outputStmt.documentType));
+
+        // evaluate
+        clock_t timer = clock();
+        ret = uniform_grid::evaluate(R->dataset, S->dataset);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        logger::log_success("Evaluation finished in", (clock()-timer) / (double)(CLOCKS_PER_SEC), "seconds");
+        if (R->dataset->geometryCache != nullptr) {
+            R->dataset->geometryCache->printStatistics();
+        }
+        if (S != R && S->dataset->geometryCache != nullptr) {
+            S->dataset->geometryCache->printStatistics();
+        }
+        return ret;
+    }
+
+    DB_STATUS run() {
+        DB_STATUS ret = DBERR_OK;
+        std::unordered_map<std::string, LoadedDataset> loaded;
+        // find the last job of each dataset
+        std::unordered_map<std::string, size_t> lastJob;
+        for (size_t i=0; i<g_config.jobs.size(); i++) {
+            lastJob[g_config.jobs[i].datasetR.key] = i;
+            lastJob[g_config.jobs[i].datasetS.key] = i;
+        }
+
+        for (size_t i=0; i<g_config.jobs.size(); i++) {
+            JobStatement &job = g_config.jobs[i];
+            logger::log_task("Job", i+1, "of", g_config.jobs.size(), ":", job.datasetR.nickname, "-", job.datasetS.nickname, "with", job.partitionsPerDim, "partitions per dimension");
+            ret = runJob(job, loaded);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Job", i+1, "failed.");
+                return ret;
+            }
+            // drop the datasets that are not used by any later job
+            g_config.datasetMetadata.setJoinDatasets(nullptr, nullptr);
+            for (std::string key : {job.datasetR.key, job.datasetS.key}) {
+                if (lastJob[key] == i && loaded.find(key) != loaded.end()) {
+                    loaded.erase(key);
+                    g_config.datasetMetadata.removeDataset(key);
+                }
+            }
+        }
+        return ret;
+    }
+}
@@ -0,0 +1,218 @@
+#include "binary.h"
+
+namespace binary
+{
+    template<typename T>
+    static inline bool writeRecord(std::ofstream &fout, const T &record) {
+        fout.write(reinterpret_cast<const char*>(&record), sizeof(T));
+        return (bool) fout;
+    }
+
+    DB_STATUS writeObjects(std::ofstream &fout, std::vector<Shape*> &objects) {
+        Header header;
+        memcpy(header.magic, DAT_MAGIC, sizeof(DAT_MAGIC));
+        header.version = DAT_VERSION;
+        header.reserved = 0;
+        header.objectCount = 0;
+        header.ringCount = 0;
+        header.vertexCount = 0;
+        // build the name dictionary and count the rings/vertices
+        // (pool name ID -> file name ID)
+        std::unordered_map<uint32_t, uint32_t> nameIDs;
+        std::vector<std::string_view> names;
+        header.nameBytes = 0;
+        for (auto &object : objects) {
+            header.objectCount++;
+            object->forEachRing([&header](const bg_point_xy* points, size_t count, bool outer) {
+                header.ringCount++;
+                header.vertexCount += count;
+            });
+            auto it = nameIDs.find(object->nameID);
+            if (it == nameIDs.end()) {
+                nameIDs.emplace(object->nameID, (uint32_t) names.size());
+                names.emplace_back(object->getName());
+                header.nameBytes += names.back().length();
+            }
+        }
+        header.nameCount = names.size();
+
+        bool ok = writeRecord(fout, header);
+        // objects
+        uint64_t ringOffset = 0;
+        for (auto &object : objects) {
+            ObjectRecord record;
+            record.recID = object->recID;
+            record.dataType = object->type;
+            record.nameID = nameIDs[object->nameID];
+            record.xMin = object->mbr.pMin.x;
+            record.yMin = object->mbr.pMin.y;
+            record.xMax = object->mbr.pMax.x;
+            record.yMax = object->mbr.pMax.y;
+            record.ringOffset = ringOffset;
+            record.ringCount = 0;
+            object->forEachRing([&record](const bg_point_xy* points, size_t count, bool outer) {
+                record.ringCount++;
+            });
+            ringOffset += record.ringCount;
+            ok = ok && writeRecord(fout, record);
+        }
+        // rings
+        uint64_t vertexOffset = 0;
+        for (auto &object : objects) {
+            object->forEachRing([&](const bg_point_xy* points, size_t count, bool outer) {
+                RingRecord ring;
+                ring.vertexOffset = vertexOffset;
+                ring.vertexCount = count;
+                ring.outer = outer;
+                vertexOffset += count;
+                ok = ok && writeRecord(fout, ring);
+            });
+        }
+        // vertices
+        for (auto &object : objects) {
+            object->forEachRing([&](const bg_point_xy* points, size_t count, bool outer) {
+                for (size_t i=0; i<count; i++) {
+                    double coords[2] = {points[i].x(), points[i].y()};
+                    fout.write(reinterpret_cast<const char*>(coords), sizeof(coords));
+                }
+            });
+        }
+        // name dictionary
+        uint64_t nameOffset = 0;
+        for (auto &name : names) {
+            ok = ok && writeRecord(fout, nameOffset);
+            nameOffset += name.length();
+        }
+        ok = ok && writeRecord(fout, nameOffset);
+        for (auto &name : names) {
+            fout.write(name.data(), name.length());
+        }
+        if (!ok || fout.fail()) {
+            logger::log_error(DBERR_FILE_WRITE, "Failed to write binary objects.");
+            return DBERR_FILE_WRITE;
+        }
+        return DBERR_OK;
+    }
+
+    DB_STATUS writeDataset(std::string &path, std::vector<std::vector<Shape>> &chunkObjects) {
+        std::vector<Shape*> objects;
+        for (auto &chunk : chunkObjects) {
+            for (auto &object : chunk) {
+                objects.emplace_back(&object);
+            }
+        }
+        std::ofstream fout(path, std::ios::out | std::ios::binary);
+        if (!fout.is_open()) {
+            logger::log_error(DBERR_FILE_OPEN, "Failed to open binary dataset file:", path);
+            return DBERR_FILE_OPEN;
+        }
+        DB_STATUS ret = writeObjects(fout, objects);
+        fout.close();
+        if (ret != DBERR_OK || fout.fail()) {
+            logger::log_error(DBERR_FILE_WRITE, "Failed to write binary dataset file:", path);
+            return DBERR_FILE_WRITE;
+        }
+        logger::log_success("Wrote", objects.size(), "objects to", path);
+        return DBERR_OK;
+    }
+
+    DB_STATUS readObjects(const char* data, size_t size, std::vector<std::vector<Shape>> &chunkObjects) {
+        // verify the header and the section sizes
+        const Header* header = reinterpret_cast<const Header*>(data);
+        if (size < sizeof(Header) || memcmp(header->magic, DAT_MAGIC, sizeof(DAT_MAGIC)) != 0 || header->version != DAT_VERSION) {
+            logger::log_error(DBERR_INVALID_PARAMETER, "Invalid binary objects header (or unsupported version).");
+            return DBERR_INVALID_PARAMETER;
+        }
+        size_t objectsStart = sizeof(Header);
+        size_t ringsStart = objectsStart + header->objectCount * sizeof(ObjectRecord);
+        size_t verticesStart = ringsStart + header->ringCount * sizeof(RingRecord);
+        size_t nameOffsetsStart = verticesStart + header->vertexCount * sizeof(bg_point_xy);
+        size_t nameBytesStart = nameOffsetsStart + (header->nameCount + 1) * sizeof(uint64_t);
+        if (size != nameBytesStart + header->nameBytes) {
+            logger::log_error(DBERR_INVALID_PARAMETER, "Binary objects are truncated or corrupt.");
+            return DBERR_INVALID_PARAMETER;
+        }
+        static_assert(sizeof(bg_point_xy) == 2 * sizeof(double), "boost points are expected to be stored as two doubles");
+        const ObjectRecord* objects = reinterpret_cast<const ObjectRecord*>(data + objectsStart);
+        const RingRecord* rings = reinterpret_cast<const RingRecord*>(data + ringsStart);
+        const bg_point_xy* vertices = reinterpret_cast<const bg_point_xy*>(data + verticesStart);
+        const uint64_t* nameOffsets = reinterpret_cast<const uint64_t*>(data + nameOffsetsStart);
+        const char* nameBytes = data + nameBytesStart;
+
+        // intern the name dictionary (serially, before any lookups)
+        std::vector<uint32_t> poolIDs(header->nameCount);
+        for (size_t i=0; i<header->nameCount; i++) {
+            if (nameOffsets[i] > nameOffsets[i+1] || nameOffsets[i+1] > header->nameBytes) {
+                logger::log_error(DBERR_INVALID_PARAMETER, "Invalid binary name dictionary.");
+                return DBERR_INVALID_PARAMETER;
+            }
+            poolIDs[i] = g_config.datasetMetadata.namePool.intern(std::string_view(nameBytes + nameOffsets[i], nameOffsets[i+1] - nameOffsets[i]));
+        }
+
+        // one contiguous range of objects per thread
+        int numChunks = std::max(1, g_config.getNumThreads());
+        size_t objectCount = header->objectCount;
+        chunkObjects.clear();
+        chunkObjects.resize(numChunks);
+        std::vector<DB_STATUS> chunkRet(numChunks, DBERR_OK);
+
+        #pragma omp parallel for num_threads(numChunks) schedule(static, 1)
+        for (int c=0; c<numChunks; c++) {
+            size_t begin = (objectCount * c) / numChunks;
+            size_t end = (objectCount * (c+1)) / numChunks;
+            chunkObjects[c].reserve(end - begin);
+            for (size_t i=begin; i<end; i++) {
+                const ObjectRecord &record = objects[i];
+                if (record.ringOffset + record.ringCount > header->ringCount || record.nameID >= header->nameCount) {
+                    chunkRet[c] = DBERR_INVALID_PARAMETER;
+                    break;
+                }
+                Shape object;
+                DB_STATUS local_ret = shape_factory::createEmpty((DataType) record.dataType, object);
+                if (local_ret != DBERR_OK) {
+                    chunkRet[c] = local_ret;
+                    break;
+                }
+                object.recID = record.recID;
+                for (size_t r=record.ringOffset; r<record.ringOffset+record.ringCount; r++) {
+                    if (rings[r].vertexOffset + rings[r].vertexCount > header->vertexCount) {
+                        local_ret = DBERR_INVALID_PARAMETER;
+                        break;
+                    }
+                    object.addRing(vertices + rings[r].vertexOffset, rings[r].vertexCount, rings[r].outer);
+                }
+                if (local_ret != DBERR_OK) {
+                    chunkRet[c] = local_ret;
+                    break;
+                }
+                object.setMBR(record.xMin, record.yMin, record.xMax, record.yMax);
+                object.nameID = poolIDs[record.nameID];
+                chunkObjects[c].emplace_back(std::move(object));
+            }
+        }
+        for (auto &it : chunkRet) {
+            if (it != DBERR_OK) {
+                logger::log_error(it, "Invalid binary object record.");
+                return it;
+            }
+        }
+        return DBERR_OK;
+    }
+
+    DB_STATUS loadDataset(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
+        DB_STATUS ret = DBERR_OK;
+        MappedFile file;
+        ret = file.map(dataset->path);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed to open dataset path:", dataset->path);
+            return ret;
+        }
+        ret = readObjects(file.data, file.size, chunkObjects);
+        file.unmap();
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed to load binary dataset file:", dataset->path);
+            return ret;
+        }
+        return ret;
+    }
+}
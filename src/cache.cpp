@@ -0,0 +1,116 @@
+#include "cache.h"
+#include "loader.h"
+
+GeometryCache::GeometryCache(Dataset* dataset, size_t capacityBytes) {
+    this->dataset = dataset;
+    this->shardCapacityBytes = capacityBytes / NUM_SHARDS;
+}
+
+GeometryCache::~GeometryCache() {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+DB_STATUS GeometryCache::open() {
+    fd = ::open(dataset->path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        logger::log_error(DBERR_FILE_OPEN, "Geometry cache failed to open dataset file:", dataset->path);
+        return DBERR_FILE_OPEN;
+    }
+    return DBERR_OK;
+}
+
+/** @brief Returns the approximate memory footprint of a materialized shape. */
+static size_t getShapeBytes(Shape &shape) {
+    size_t bytes = sizeof(Shape);
+    shape.forEachRing([&bytes](const bg_point_xy* points, size_t count, bool outer) {
+        bytes += count * sizeof(bg_point_xy);
+    });
+    return bytes;
+}
+
+DB_STATUS GeometryCache::materialize(Shape* object, std::shared_ptr<Shape> &geometry) {
+    std::string line(object->lineLength, '\0');
+    ssize_t bytesRead = pread(fd, &line[0], object->lineLength, object->fileOffset);
+    if (bytesRead != (ssize_t) object->lineLength) {
+        logger::log_error(DBERR_FILE_OPEN, "Geometry cache failed to read object", object->recID, "from", dataset->path);
+        return DBERR_FILE_OPEN;
+    }
+    geometry = std::make_shared<Shape>();
+    // the name was interned when the dataset was loaded
+    DB_STATUS ret = loader::parseLine(dataset, line, object->recID, *geometry, nullptr);
+    if (ret != DBERR_OK) {
+        logger::log_error(ret, "Geometry cache failed to parse object", object->recID, "from", dataset->path);
+        return ret;
+    }
+    geometry->nameID = object->nameID;
+    geometry->setMBR();
+    return DBERR_OK;
+}
+
+Shape* GeometryCache::getGeometry(Shape* object, std::shared_ptr<Shape> &holder, bool insert) {
+    GeometryCache* cache = object->geometryCache;
+    if (cache == nullptr) {
+        // not lazy
+        return object;
+    }
+    Shard &shard = cache->shards[object->recID % NUM_SHARDS];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(object->recID);
+        if (it != shard.entries.end()) {
+            // hit, move to the front of the LRU list
+            if (insert) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruIt);
+                cache->hits++;
+            }
+            holder = it->second.shape;
+            return holder.get();
+        }
+    }
+    // miss, parse without holding the lock
+    std::shared_ptr<Shape> geometry;
+    if (cache->materialize(object, geometry) != DBERR_OK) {
+        return nullptr;
+    }
+    if (!insert) {
+        holder = geometry;
+        return holder.get();
+    }
+    cache->misses++;
+    size_t bytes = getShapeBytes(*geometry);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(object->recID);
+    if (it != shard.entries.end()) {
+        // another thread materialized it in the meantime
+        holder = it->second.shape;
+        return holder.get();
+    }
+    shard.lru.push_front(object->recID);
+    shard.entries[object->recID] = {geometry, bytes, shard.lru.begin()};
+    shard.bytes += bytes;
+    // evict least recently used entries (never the new one)
+    if (cache->shardCapacityBytes > 0) {
+        while (shard.bytes > cache->shardCapacityBytes && shard.lru.size() > 1) {
+            auto evicted = shard.entries.find(shard.lru.back());
+            shard.bytes -= evicted->second.bytes;
+            shard.entries.erase(evicted);
+            shard.lru.pop_back();
+            cache->evictions++;
+        }
+    }
+    holder = geometry;
+    return holder.get();
+}
+
+void GeometryCache::printStatistics() {
+    size_t bytes = 0;
+    size_t entries = 0;
+    for (int i=0; i<NUM_SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        bytes += shards[i].bytes;
+        entries += shards[i].entries.size();
+    }
+    logger::log_success("Dataset", dataset->nickname, "geometry cache: hits", hits.load(), "misses", misses.load(), "evictions", evictions.load(), "cached", entries, "geometries,", bytes / (1024.0 * 1024.0), "MB");
+}
@@ -5,22 +5,29 @@ namespace config
     DB_STATUS setup(ArgumentsStatement &argStmt) {
         DB_STATUS ret = DBERR_OK;
         Dataset R(argStmt.datasetR);
-        Dataset S(argStmt.datasetS);
         // add datasets to config
         ret = g_config.datasetMetadata.addDataset(DATASET_R, R);
         if (ret != DBERR_OK) {
             logger::log_error(ret, "Failed while adding dataset R to config.");
             return ret;
         }
-        ret = g_config.datasetMetadata.addDataset(DATASET_S, S);
-        if (ret != DBERR_OK) {
-            logger::log_error(ret, "Failed while adding dataset R to config.");
-            return ret;
-        }
-        // check if self-join
-        if (g_config.datasetMetadata.getDatasetR()->path.compare(g_config.datasetMetadata.getDatasetS()->path) == 0) {
+        // check if self-join: S is then an alias of R, so the file is loaded and indexed once
+        if (argStmt.datasetsS.size() == 1 && argStmt.datasetR.path.compare(argStmt.datasetsS.front().path) == 0) {
+            g_config.datasetMetadata.setJoinDatasets(g_config.datasetMetadata.getDatasetR(), g_config.datasetMetadata.getDatasetR());
             g_config.datasetMetadata.setSelfJoin(true);
             logger::log_success("Self-join enabled.");
+        } else {
+            for (auto &datasetS : argStmt.datasetsS) {
+                Dataset S(datasetS);
+                ret = g_config.datasetMetadata.addDataset(DATASET_S, S);
+                if (ret != DBERR_OK) {
+                    logger::log_error(ret, "Failed while adding dataset S to config.");
+                    return ret;
+                }
+            }
+            if (argStmt.datasetsS.size() > 1) {
+                logger::log_success("Multi-way join enabled with", argStmt.datasetsS.size(), "S datasets.");
+            }
         }
         // open output file
         ret = g_config.diskWriter.openOutputFilestream(argStmt.outputStmt.outputFilepath, argStmt.outputStmt.append);
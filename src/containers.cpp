@@ -1,4 +1,5 @@
 #include "containers.h"
+#include "index/create.h"
 
 Config g_config;
 
@@ -31,8 +32,9 @@ DB_STATUS Dataset::addObject(Shape &object) {
         return DBERR_INVALID_KEY;
     }
     // insert reference to partition index
-    for (int i=0; i<object.getPartitionCount(); i++) {
-        this->uniformGridIndex.addObject(object.getPartitionID(i), objectRef);
+    DB_STATUS ret = this->uniformGridIndex.addObject(objectRef);
+    if (ret != DBERR_OK) {
+        return ret;
     }
     // keep the ID in the list
     objectIDs.push_back(object.recID);
@@ -59,8 +61,10 @@ void Dataset::printPartitionContents(int partitionID) {
     printf("Partition %d contents:\n", partitionID);
     Partition* partition = uniformGridIndex.getPartition(partitionID);
     if (partition != nullptr) {
-        for(auto &it: *partition->getContents()) {
-            this->getObject(it->recID)->printGeometry();
+        for (int c=CLASS_A; c<=CLASS_D; c++) {
+            for(auto &it: partition->getContents((TwoLayerClass) c)->objects) {
+                this->getObject(it->recID)->printGeometry();
+            }
         }
         printf("\n");
     } else {
@@ -70,10 +74,18 @@ void Dataset::printPartitionContents(int partitionID) {
 }
 
 void Dataset::printPartitionStatistics() {
+    if (g_config.indexConfig.indexType == IT_RTREE) {
+        size_t leaves = 0;
+        for (auto &node : this->rtreeIndex.nodes) {
+            leaves += node.leaf;
+        }
+        logger::log_success("Dataset", this->nickname, "R-tree nodes:", this->rtreeIndex.nodes.size(), "with height", this->rtreeIndex.height, "and avg objects per leaf:", this->rtreeIndex.entries.size() / (double) leaves);
+        return;
+    }
     size_t totalObjectsInPartitions = 0;
     size_t totalPartitions = this->uniformGridIndex.partitions.size();
     for (auto &partition : this->uniformGridIndex.partitions) {
-        totalObjectsInPartitions += partition.getContents()->size();
+        totalObjectsInPartitions += partition.getObjectCount();
     }
 
     logger::log_success("Dataset", this->nickname, "non-empty partitions:", totalPartitions, "with avg objects per partition:", totalObjectsInPartitions / (double) totalPartitions);
@@ -126,8 +138,10 @@ void DatasetMetadata::clear() {
     numberOfDatasets = 0;
     R = nullptr;
     S = nullptr;
+    datasetsS.clear();
     datasets.clear();
     dataspaceMetadata.clear();
+    namePool.clear();
 }
 
 Dataset* DatasetMetadata::getDatasetR() {
@@ -138,6 +152,10 @@ Dataset* DatasetMetadata::getDatasetS() {
     return S;
 }
 
+std::vector<Dataset*>& DatasetMetadata::getDatasetsS() {
+    return datasetsS;
+}
+
 Dataset* DatasetMetadata::getDatasetByIdx(DatasetIndex datasetIndex) {
     switch (datasetIndex) {
         case DATASET_R:
@@ -149,7 +167,7 @@ Dataset* DatasetMetadata::getDatasetByIdx(DatasetIndex datasetIndex) {
     return nullptr;
 }
 /**
-@brief adds a Dataset to the configuration's dataset metadata
+@brief adds a Dataset to the configuration's dataset metadata. Each added S dataset is appended to the S datasets.
  * @warning it has to be an empty dataset BUT its nickname needs to be set
  */
 DB_STATUS DatasetMetadata::addDataset(DatasetIndex datasetIdx, Dataset &dataset) {
@@ -162,7 +180,8 @@ DB_STATUS DatasetMetadata::addDataset(DatasetIndex datasetIdx, Dataset &dataset)
             break;
         case DATASET_S:
             // S is being added
-            S = &datasets[dataset.key];
+            datasetsS.emplace_back(&datasets[dataset.key]);
+            S = datasetsS.front();
             break;
         default:
             logger::log_error(DBERR_INVALID_PARAMETER, "Invalid dataset index. Use only DATASET_R or DATASET_S.");
@@ -173,19 +192,43 @@ DB_STATUS DatasetMetadata::addDataset(DatasetIndex datasetIdx, Dataset &dataset)
 }
 
 void DatasetMetadata::updateDataspace() {
-    // find the bounds that enclose both datasets
-    for (auto &it: datasets) {
-        dataspaceMetadata.xMinGlobal = std::min(dataspaceMetadata.xMinGlobal, it.second.dataspaceMetadata.xMinGlobal);
-        dataspaceMetadata.yMinGlobal = std::min(dataspaceMetadata.yMinGlobal, it.second.dataspaceMetadata.yMinGlobal);
-        dataspaceMetadata.xMaxGlobal = std::max(dataspaceMetadata.xMaxGlobal, it.second.dataspaceMetadata.xMaxGlobal);
-        dataspaceMetadata.yMaxGlobal = std::max(dataspaceMetadata.yMaxGlobal, it.second.dataspaceMetadata.yMaxGlobal);
+    // find the bounds that enclose all datasets
+    std::vector<Dataset*> joinDatasets = datasetsS;
+    joinDatasets.emplace_back(R);
+    for (Dataset* dataset : joinDatasets) {
+        dataspaceMetadata.xMinGlobal = std::min(dataspaceMetadata.xMinGlobal, dataset->dataspaceMetadata.xMinGlobal);
+        dataspaceMetadata.yMinGlobal = std::min(dataspaceMetadata.yMinGlobal, dataset->dataspaceMetadata.yMinGlobal);
+        dataspaceMetadata.xMaxGlobal = std::max(dataspaceMetadata.xMaxGlobal, dataset->dataspaceMetadata.xMaxGlobal);
+        dataspaceMetadata.yMaxGlobal = std::max(dataspaceMetadata.yMaxGlobal, dataset->dataspaceMetadata.yMaxGlobal);
     }
     dataspaceMetadata.xExtent = dataspaceMetadata.xMaxGlobal - dataspaceMetadata.xMinGlobal;
     dataspaceMetadata.yExtent = dataspaceMetadata.yMaxGlobal - dataspaceMetadata.yMinGlobal;
-    // set as both datasets' bounds
-    for (auto &it: datasets) {
-        it.second.dataspaceMetadata = dataspaceMetadata;
+    // set as all datasets' bounds
+    for (Dataset* dataset : joinDatasets) {
+        dataset->dataspaceMetadata = dataspaceMetadata;
+    }
+}
+
+void DatasetMetadata::setJoinDatasets(Dataset* R, Dataset* S) {
+    this->R = R;
+    this->S = S;
+    datasetsS.clear();
+    if (S != nullptr) {
+        datasetsS.emplace_back(S);
+    }
+}
+
+void DatasetMetadata::removeDataset(std::string &key) {
+    auto it = datasets.find(key);
+    if (it == datasets.end()) {
+        return;
     }
+    if (R == &it->second) {
+        R = nullptr;
+    }
+    datasetsS.erase(std::remove(datasetsS.begin(), datasetsS.end(), &it->second), datasetsS.end());
+    S = datasetsS.empty() ? nullptr : datasetsS.front();
+    datasets.erase(it);
 }
 
 void DatasetMetadata::setSelfJoin(bool val) {
@@ -196,54 +239,187 @@ bool DatasetMetadata::getSelfJoin() {
     return this->selfJoin;
 }
 
+void UniformGridIndex::initDirectory() {
+    if (partitionsPerDim != 0) {
+        return;
+    }
+    partitionsPerDim = g_config.indexConfig.partitionsPerDim;
+    blocksPerDim = (partitionsPerDim + GridBlock::BLOCK_SIDE - 1) / GridBlock::BLOCK_SIDE;
+    size_t blockCount = (size_t) blocksPerDim * blocksPerDim;
+    blockSlots.assign(blockCount, -1);
+    blockOccupancy.assign((blockCount + 63) / 64, 0);
+}
+
 Partition* UniformGridIndex::getOrCreatePartition(int partitionID) {
-    // return &it->second;
-    auto it = partitionMap.find(partitionID);
-    if (it == partitionMap.end()) {
-        // new partition
-        Partition partition(partitionID);
-        partitions.push_back(partition);
-        size_t newIndex = partitions.size() - 1;
-        partitionMap[partitionID] = newIndex;
-        return &partitions[newIndex];
+    int32_t slot = getPartitionSlot(partitionID);
+    if (slot >= 0) {
+        // existing partition
+        return &partitions[slot];
+    }
+    // new partition
+    initDirectory();
+    int i = partitionID % partitionsPerDim;
+    int j = partitionID / partitionsPerDim;
+    size_t blockIndex = (i / GridBlock::BLOCK_SIDE) + (j / GridBlock::BLOCK_SIDE) * blocksPerDim;
+    if (blockSlots[blockIndex] < 0) {
+        // new block
+        blockSlots[blockIndex] = blocks.size();
+        blocks.emplace_back();
+        blockOccupancy[blockIndex / 64] |= 1ULL << (blockIndex % 64);
     }
-    // existing partition
-    return &partitions[it->second];
+    GridBlock &block = blocks[blockSlots[blockIndex]];
+    int cellIndex = (i % GridBlock::BLOCK_SIDE) + (j % GridBlock::BLOCK_SIDE) * GridBlock::BLOCK_SIDE;
+    block.cellSlots[cellIndex] = partitions.size();
+    block.occupancy[cellIndex / 64] |= 1ULL << (cellIndex % 64);
+    partitions.emplace_back(partitionID);
+    return &partitions.back();
+}
+
+DB_STATUS UniformGridIndex::addObject(Shape* objectRef) {
+    if (!objectRef->hasCellRange()) {
+        return DBERR_OK;
+    }
+    if (g_config.indexConfig.indexType == IT_QUADTREE) {
+        std::vector<int> partitionIDs;
+        DB_STATUS ret = quadtree::getPartitionsForCellRange(objectRef->minCellX, objectRef->minCellY, objectRef->maxCellX, objectRef->maxCellY, partitionIDs);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        for (auto &partitionID : partitionIDs) {
+            addObject(partitionID, objectRef);
+        }
+        return DBERR_OK;
+    }
+    for (int i=objectRef->minCellX; i<=objectRef->maxCellX; i++) {
+        for (int j=objectRef->minCellY; j<=objectRef->maxCellY; j++) {
+            addObject(uniform_grid::getPartitionID(i, j, g_config.indexConfig.partitionsPerDim), objectRef);
+        }
+    }
+    return DBERR_OK;
 }
 
 void UniformGridIndex::addObject(int partitionID, Shape* objectRef) {
-    auto it = partitionMap.find(partitionID);
-    if (it == partitionMap.end()) {
-        // new partition
-        Partition partition(partitionID);
-        // add object reference
-        partition.addObject(objectRef);
-        // save partition
-        partitions.push_back(partition);
-        int newIndex = partitions.size() - 1;
-        partitionMap[partitionID] = newIndex;
+    Partition* partition = getOrCreatePartition(partitionID);
+    // the object starts inside the partition in a dimension if its first cell is not an earlier one
+    bool startsInX = objectRef->minCellX >= partitionID % partitionsPerDim;
+    bool startsInY = objectRef->minCellY >= partitionID / partitionsPerDim;
+    if (startsInX) {
+        partition->addObject(objectRef, startsInY ? CLASS_A : CLASS_C);
     } else {
-        // existing partition
-        partitions[it->second].addObject(objectRef);
+        partition->addObject(objectRef, startsInY ? CLASS_B : CLASS_D);
     }
 }
 
 Partition* UniformGridIndex::getPartition(int partitionID) {
-    auto it = partitionMap.find(partitionID);
-    if (it == partitionMap.end()) {
+    int32_t slot = getPartitionSlot(partitionID);
+    if (slot < 0) {
         // does not exist
         return nullptr;
     } 
     // exists
-    return &partitions[it->second];
+    return &partitions[slot];
 }
 
-std::vector<Shape*>* Partition::getContents() {
-    return &contents;
+DB_STATUS UniformGridIndex::getCommonPartitions(UniformGridIndex &other, std::vector<std::pair<Partition*, Partition*>> &commonPartitions) {
+    commonPartitions.clear();
+    if (partitionsPerDim == 0 || other.partitionsPerDim == 0) {
+        // (at least) one empty index
+        return DBERR_OK;
+    }
+    if (partitionsPerDim != other.partitionsPerDim) {
+        logger::log_error(DBERR_INVALID_PARAMETER, "Indexes with different grids can not be joined:", partitionsPerDim, "and", other.partitionsPerDim, "partitions per dimension.");
+        return DBERR_INVALID_PARAMETER;
+    }
+    bool thisDrives = partitions.size() <= other.partitions.size();
+    std::vector<Partition> &driverPartitions = thisDrives ? partitions : other.partitions;
+    if (driverPartitions.size() < blockOccupancy.size()) {
+        // sparse driver: probe its partitions in the other directory, keeping the (this, other) order of the pairs
+        UniformGridIndex &probed = thisDrives ? other : *this;
+        for (auto &partition : driverPartitions) {
+            int32_t slot = probed.getPartitionSlot(partition.partitionID);
+            if (slot < 0) {
+                continue;
+            }
+            if (thisDrives) {
+                commonPartitions.emplace_back(&partition, &probed.partitions[slot]);
+            } else {
+                commonPartitions.emplace_back(&probed.partitions[slot], &partition);
+            }
+        }
+        return DBERR_OK;
+    }
+    for (size_t w=0; w<blockOccupancy.size(); w++) {
+        uint64_t commonBlocks = blockOccupancy[w] & other.blockOccupancy[w];
+        while (commonBlocks) {
+            size_t blockIndex = w * 64 + __builtin_ctzll(commonBlocks);
+            commonBlocks &= commonBlocks - 1;
+            GridBlock &block = blocks[blockSlots[blockIndex]];
+            GridBlock &otherBlock = other.blocks[other.blockSlots[blockIndex]];
+            for (int c=0; c<GridBlock::BLOCK_CELLS / 64; c++) {
+                uint64_t commonCells = block.occupancy[c] & otherBlock.occupancy[c];
+                while (commonCells) {
+                    int cellIndex = c * 64 + __builtin_ctzll(commonCells);
+                    commonCells &= commonCells - 1;
+                    commonPartitions.emplace_back(&partitions[block.cellSlots[cellIndex]], &other.partitions[otherBlock.cellSlots[cellIndex]]);
+                }
+            }
+        }
+    }
+    return DBERR_OK;
+}
+
+void UniformGridIndex::sortPartitions() {
+    #pragma omp parallel for num_threads(std::max(1, g_config.getNumThreads())) schedule(dynamic, 64)
+    for (size_t i=0; i<partitions.size(); i++) {
+        for (auto &contents : partitions[i].classIndex) {
+            std::sort(contents.objects.begin(), contents.objects.end(), compareByY);
+            contents.refreshMBRs();
+        }
+    }
+}
+
+void UniformGridIndex::clear() {
+    partitions.clear();
+    partitionsPerDim = 0;
+    blocksPerDim = 0;
+    blockSlots.clear();
+    blockOccupancy.clear();
+    blocks.clear();
+}
+
+void RTreeIndex::clear() {
+    nodes.clear();
+    entries.clear();
+    height = 0;
+}
+
+void ClassContents::addObject(Shape* objectRef) {
+    objects.emplace_back(objectRef);
+    xMin.emplace_back(objectRef->mbr.pMin.x);
+    yMin.emplace_back(objectRef->mbr.pMin.y);
+    xMax.emplace_back(objectRef->mbr.pMax.x);
+    yMax.emplace_back(objectRef->mbr.pMax.y);
 }
 
-void Partition::addObject(Shape *objectRef) {
-    contents.emplace_back(objectRef);
+void ClassContents::refreshMBRs() {
+    for (size_t i=0; i<objects.size(); i++) {
+        xMin[i] = objects[i]->mbr.pMin.x;
+        yMin[i] = objects[i]->mbr.pMin.y;
+        xMax[i] = objects[i]->mbr.pMax.x;
+        yMax[i] = objects[i]->mbr.pMax.y;
+    }
+}
+
+ClassContents* Partition::getContents(TwoLayerClass objectClass) {
+    return &classIndex[objectClass];
+}
+
+void Partition::addObject(Shape *objectRef, TwoLayerClass objectClass) {
+    classIndex[objectClass].addObject(objectRef);
+}
+
+size_t Partition::getObjectCount() {
+    return classIndex[CLASS_A].size() + classIndex[CLASS_B].size() + classIndex[CLASS_C].size() + classIndex[CLASS_D].size();
 }
 
 namespace shape_factory
@@ -305,20 +481,29 @@ DB_STATUS DiskWriter::writeBuffers() {
     switch (this->docType) {
         case DOC_PARAGRAPHS:
         case DOC_PARAGRAPHS_COMPRESSED:
-            for (auto &it : this->entityRelationMap) {
-                if (!(this->output << it.first + " topological relations: ")) {
+            // merge the threads' texts into the first map
+            for (int i=1; i<this->entityRelationMaps.size(); i++) {
+                for (auto &it : this->entityRelationMaps[i]) {
+                    this->entityRelationMaps[0][it.first] += it.second;
+                }
+                this->entityRelationMaps[i].clear();
+            }
+            for (auto &it : this->entityRelationMaps[0]) {
+                if (!(this->output << g_config.datasetMetadata.namePool.get(it.first) << " topological relations: ")) {
                     return DBERR_FILE_WRITE;
                 }
                 if (!(this->output << it.second << std::endl)) {
                     return DBERR_FILE_WRITE;
                 }
             }
+            this->entityRelationMaps[0].clear();
             break;
         case DOC_SENTENCES:
             for (auto &buf : this->buffers) {
                 if (!(this->output << buf)) {
                     return DBERR_FILE_WRITE;
                 }
+                buf.clear();
             }
             break;
     }
@@ -380,14 +565,35 @@ DocumentType DiskWriter::getDocumentType() {
     return this->docType;
 }
 
-
-void DiskWriter::appendTextForEntity(std::string entityKey, std::string text) {   
-    auto it = this->entityRelationMap.find(entityKey);
-    if (it == this->entityRelationMap.end()) {
-        // new entry, set
-        this->entityRelationMap[entityKey] = text;
-    } else {
-        // entity exists, append
-        this->entityRelationMap[entityKey] += text;
+uint32_t NamePool::intern(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = nameIDs.find(name);
+    if (it != nameIDs.end()) {
+        return it->second;
+    }
+    // copy the name into the arena
+    if (blockUsed + name.length() > BLOCK_SIZE) {
+        blocks.emplace_back(new char[std::max(BLOCK_SIZE, name.length())]);
+        blockUsed = 0;
     }
+    char* storage = blocks.back().get() + blockUsed;
+    memcpy(storage, name.data(), name.length());
+    blockUsed += name.length();
+    uint32_t nameID = names.size();
+    names.emplace_back(storage, name.length());
+    nameIDs.emplace(names.back(), nameID);
+    return nameID;
+}
+
+size_t NamePool::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.size();
+}
+
+void NamePool::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    blocks.clear();
+    blockUsed = BLOCK_SIZE;
+    names.clear();
+    nameIDs.clear();
 }
@@ -0,0 +1,502 @@
+#include "index/april.h"
+
+namespace april
+{
+    /** @brief The margin (in cells) within which the boundary of an object is considered to touch a cell. */
+    static const double CELL_MARGIN = 1e-9;
+
+    /** @brief The APRIL grid: 2^order x 2^order cells over the global dataspace. */
+    struct Grid {
+        int order;
+        uint32_t cellsPerDim;
+        double xMin, yMin;
+        double cellWidth, cellHeight;
+
+        Grid(int order, DataspaceMetadata &dataspace) {
+            this->order = order;
+            cellsPerDim = (uint32_t) 1 << order;
+            xMin = dataspace.xMinGlobal;
+            yMin = dataspace.yMinGlobal;
+            cellWidth = std::max(dataspace.xExtent, EPS) / cellsPerDim;
+            cellHeight = std::max(dataspace.yExtent, EPS) / cellsPerDim;
+        }
+
+        /** @brief Converts the x coordinate to grid units (cell i spans [i, i+1]). */
+        inline double toGridX(double x) const {
+            return std::min(std::max((x - xMin) / cellWidth, 0.0), (double) cellsPerDim);
+        }
+
+        inline double toGridY(double y) const {
+            return std::min(std::max((y - yMin) / cellHeight, 0.0), (double) cellsPerDim);
+        }
+
+        /** @brief Returns the cell that contains the grid coordinate, clamped to the grid. */
+        inline int toCell(double gridCoord) const {
+            return std::min(std::max((int) std::floor(gridCoord), 0), (int) cellsPerDim - 1);
+        }
+
+        /** @brief Returns the number of cell (x, y) along the Hilbert curve. */
+        uint32_t getHilbertNumber(uint32_t x, uint32_t y) const {
+            uint64_t d = 0;
+            for (uint32_t s = cellsPerDim / 2; s > 0; s /= 2) {
+                uint32_t rx = (x & s) > 0;
+                uint32_t ry = (y & s) > 0;
+                d += (uint64_t) s * s * ((3 * rx) ^ ry);
+                // rotate the quadrant
+                if (ry == 0) {
+                    if (rx == 1) {
+                        x = cellsPerDim - 1 - x;
+                        y = cellsPerDim - 1 - y;
+                    }
+                    std::swap(x, y);
+                }
+            }
+            return (uint32_t) d;
+        }
+    };
+
+    /** @brief An edge of the object's rings, in grid units. */
+    struct Edge {
+        double x0, y0, x1, y1;
+    };
+
+    /**
+    @brief Rasterizes one areal object. The cells that the boundary touches are found per edge, and the rest of the cells
+     * of the object's MBR are classified by the parity of the edge crossings of their row's center line, one block at a time:
+     * the grid is traversed as a quadtree, and a block that the boundary does not touch is entirely inside or outside.
+     * Aligned blocks are contiguous ranges of the Hilbert curve, so each block inside the object yields a single interval.
+     */
+    class Rasterizer {
+    private:
+        const Grid &grid;
+        int minCellX, minCellY, maxCellX, maxCellY;
+        /** @brief Per row of the MBR: the sorted columns of the cells that the boundary touches. */
+        std::vector<std::vector<int>> boundaryCells;
+        /** @brief Per row of the MBR: the sorted x coordinates where the edges cross the row's center line. */
+        std::vector<std::vector<double>> crossings;
+        std::vector<std::pair<uint32_t, uint32_t>> allRanges, fullRanges;
+
+        void addEdge(const Edge &edge) {
+            double xLow = std::min(edge.x0, edge.x1), xHigh = std::max(edge.x0, edge.x1);
+            double yLow = std::min(edge.y0, edge.y1), yHigh = std::max(edge.y0, edge.y1);
+            // crossings of the row center lines y = j + 0.5 with yLow <= y < yHigh
+            int firstRow = std::max((int) std::ceil(yLow - 0.5), minCellY);
+            int lastRow = std::min((int) std::ceil(yHigh - 0.5) - 1, maxCellY);
+            for (int j=firstRow; j<=lastRow; j++) {
+                double y = j + 0.5;
+                crossings[j - minCellY].emplace_back(edge.x0 + (y - edge.y0) * (edge.x1 - edge.x0) / (edge.y1 - edge.y0));
+            }
+            // cells within the margin of the edge, column by column
+            int firstColumn = std::max((int) std::floor(xLow - CELL_MARGIN), minCellX);
+            int lastColumn = std::min((int) std::floor(xHigh + CELL_MARGIN), maxCellX);
+            for (int i=firstColumn; i<=lastColumn; i++) {
+                // the y range of the part of the edge in the (expanded) column
+                double yFrom = yLow, yTo = yHigh;
+                if (edge.x1 != edge.x0) {
+                    double xFrom = std::max(xLow, i - CELL_MARGIN);
+                    double xTo = std::min(xHigh, i + 1 + CELL_MARGIN);
+                    double yAtFrom = edge.y0 + (xFrom - edge.x0) * (edge.y1 - edge.y0) / (edge.x1 - edge.x0);
+                    double yAtTo = edge.y0 + (xTo - edge.x0) * (edge.y1 - edge.y0) / (edge.x1 - edge.x0);
+                    yFrom = std::min(yAtFrom, yAtTo);
+                    yTo = std::max(yAtFrom, yAtTo);
+                }
+                int firstCellRow = std::max((int) std::floor(yFrom - CELL_MARGIN), minCellY);
+                int lastCellRow = std::min((int) std::floor(yTo + CELL_MARGIN), maxCellY);
+                for (int j=firstCellRow; j<=lastCellRow; j++) {
+                    boundaryCells[j - minCellY].emplace_back(i);
+                }
+            }
+        }
+
+        /** @brief Returns true if the boundary touches a cell of the block (clipped to the MBR). */
+        bool isBoundaryBlock(int blockX, int blockY, int size) const {
+            int firstRow = std::max(blockY, minCellY), lastRow = std::min(blockY + size - 1, maxCellY);
+            for (int j=firstRow; j<=lastRow; j++) {
+                const std::vector<int> &rowCells = boundaryCells[j - minCellY];
+                auto it = std::lower_bound(rowCells.begin(), rowCells.end(), blockX);
+                if (it != rowCells.end() && *it < blockX + size) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /** @brief Returns true if the block, which the boundary does not touch, is inside the object. */
+        bool isInteriorBlock(int blockX, int blockY) const {
+            // any cell of the block in the MBR decides, by the parity of the crossings to its left
+            int cellX = std::max(blockX, minCellX);
+            const std::vector<double> &rowCrossings = crossings[std::max(blockY, minCellY) - minCellY];
+            size_t crossingsToTheLeft = std::lower_bound(rowCrossings.begin(), rowCrossings.end(), cellX + 0.5) - rowCrossings.begin();
+            return crossingsToTheLeft % 2 == 1;
+        }
+
+        void rasterizeBlock(int blockX, int blockY, int level) {
+            int size = 1 << level;
+            if (blockX > maxCellX || blockX + size - 1 < minCellX || blockY > maxCellY || blockY + size - 1 < minCellY) {
+                // outside the MBR
+                return;
+            }
+            uint64_t blockCells = (uint64_t) size * size;
+            if (!isBoundaryBlock(blockX, blockY, size)) {
+                if (isInteriorBlock(blockX, blockY)) {
+                    uint32_t first = grid.getHilbertNumber(blockX, blockY) & ~(uint32_t) (blockCells - 1);
+                    uint32_t last = (uint32_t) (first + blockCells - 1);
+                    allRanges.emplace_back(first, last);
+                    fullRanges.emplace_back(first, last);
+                }
+                return;
+            }
+            if (level == 0) {
+                uint32_t cell = grid.getHilbertNumber(blockX, blockY);
+                allRanges.emplace_back(cell, cell);
+                return;
+            }
+            int half = size / 2;
+            rasterizeBlock(blockX, blockY, level - 1);
+            rasterizeBlock(blockX + half, blockY, level - 1);
+            rasterizeBlock(blockX, blockY + half, level - 1);
+            rasterizeBlock(blockX + half, blockY + half, level - 1);
+        }
+
+        /** @brief Sorts the ranges and merges the overlapping or adjacent ones into the flattened intervals. */
+        static void mergeRanges(std::vector<std::pair<uint32_t, uint32_t>> &ranges, std::vector<uint32_t> &intervals) {
+            std::sort(ranges.begin(), ranges.end());
+            intervals.clear();
+            for (auto &range : ranges) {
+                if (!intervals.empty() && (uint64_t) range.first <= (uint64_t) intervals.back() + 1) {
+                    intervals.back() = std::max(intervals.back(), range.second);
+                } else {
+                    intervals.emplace_back(range.first);
+                    intervals.emplace_back(range.second);
+                }
+            }
+        }
+
+    public:
+        Rasterizer(const Grid &grid) : grid(grid) {}
+
+        void rasterize(Shape* object, AprilData &aprilData) {
+            minCellX = grid.toCell(grid.toGridX(object->mbr.pMin.x) - CELL_MARGIN);
+            minCellY = grid.toCell(grid.toGridY(object->mbr.pMin.y) - CELL_MARGIN);
+            maxCellX = grid.toCell(grid.toGridX(object->mbr.pMax.x) + CELL_MARGIN);
+            maxCellY = grid.toCell(grid.toGridY(object->mbr.pMax.y) + CELL_MARGIN);
+            boundaryCells.assign(maxCellY - minCellY + 1, std::vector<int>());
+            crossings.assign(maxCellY - minCellY + 1, std::vector<double>());
+            allRanges.clear();
+            fullRanges.clear();
+            object->forEachRing([this](const bg_point_xy* points, size_t count, bool outer) {
+                if (count == 0) {
+                    return;
+                }
+                // the closing edge is empty for closed rings
+                for (size_t i=0; i<count; i++) {
+                    const bg_point_xy &from = points[i];
+                    const bg_point_xy &to = points[(i + 1) % count];
+                    addEdge({grid.toGridX(from.x()), grid.toGridY(from.y()), grid.toGridX(to.x()), grid.toGridY(to.y())});
+                }
+            });
+            for (auto &rowCells : boundaryCells) {
+                std::sort(rowCells.begin(), rowCells.end());
+                rowCells.erase(std::unique(rowCells.begin(), rowCells.end()), rowCells.end());
+            }
+            for (auto &rowCrossings : crossings) {
+                std::sort(rowCrossings.begin(), rowCrossings.end());
+            }
+            rasterizeBlock(0, 0, grid.order);
+            mergeRanges(allRanges, aprilData.allIntervals);
+            mergeRanges(fullRanges, aprilData.fullIntervals);
+        }
+    };
+
+    /** @brief FNV-1a hash of the string. */
+    static uint64_t hashString(const std::string &str) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (auto &c : str) {
+            hash = (hash ^ (unsigned char) c) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /**
+    @brief Returns the path of the dataset's APRIL file in the APRIL directory, named after the dataset file and 
+     * a hash of its full path and geometry column (so datasets with the same file name do not share a file).
+     */
+    static std::string getAprilFilePath(Dataset* dataset, int order) {
+        std::string fileName = dataset->path.substr(dataset->path.find_last_of('/') + 1);
+        char pathHash[17];
+        snprintf(pathHash, sizeof(pathHash), "%016llx", (unsigned long long) hashString(dataset->path + " " + std::to_string(dataset->wktColIdx)));
+        return g_config.indexConfig.aprilDirectory + "/" + fileName + "_" + pathHash + "_" + std::to_string(order) + ".april";
+    }
+
+    static DB_STATUS save(std::string &path, Dataset* dataset) {
+        AprilIndex &aprilIndex = dataset->aprilIndex;
+        std::string key = uniform_grid::snapshot::getDatasetKey(dataset);
+        if (key.empty()) {
+            logger::log_error(DBERR_FILE_OPEN, "Failed to stat dataset file:", dataset->path);
+            return DBERR_FILE_OPEN;
+        }
+        Header header;
+        memcpy(header.magic, APRIL_MAGIC, sizeof(APRIL_MAGIC));
+        header.version = APRIL_VERSION;
+        header.order = aprilIndex.order;
+        header.xMinGlobal = aprilIndex.xMin;
+        header.yMinGlobal = aprilIndex.yMin;
+        header.xMaxGlobal = aprilIndex.xMax;
+        header.yMaxGlobal = aprilIndex.yMax;
+        header.keyLength = key.length();
+        header.objectCount = aprilIndex.objects.size();
+
+        std::ofstream fout(path, std::ios::out | std::ios::binary);
+        if (!fout.is_open()) {
+            logger::log_error(DBERR_FILE_OPEN, "Failed to open APRIL file:", path);
+            return DBERR_FILE_OPEN;
+        }
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        fout.write(key.data(), key.length());
+        for (auto &it : aprilIndex.objects) {
+            uint64_t counts[3] = {it.first, it.second.allIntervals.size(), it.second.fullIntervals.size()};
+            fout.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+            fout.write(reinterpret_cast<const char*>(it.second.allIntervals.data()), it.second.allIntervals.size() * sizeof(uint32_t));
+            fout.write(reinterpret_cast<const char*>(it.second.fullIntervals.data()), it.second.fullIntervals.size() * sizeof(uint32_t));
+        }
+        fout.close();
+        if (fout.fail()) {
+            logger::log_error(DBERR_FILE_WRITE, "Failed to write APRIL file:", path);
+            return DBERR_FILE_WRITE;
+        }
+        logger::log_success("Saved the APRIL approximations of dataset", dataset->nickname, "to", path);
+        return DBERR_OK;
+    }
+
+    /**
+    @brief Loads the approximations of the dataset from the APRIL file, if it exists and matches the dataset and grid.
+     * @param[out] loaded Set to false if the file is missing, outdated or corrupt (nothing is loaded then).
+     */
+    static DB_STATUS load(std::string &path, Dataset* dataset, bool &loaded) {
+        loaded = false;
+        if (!verifyFilepath(path)) {
+            return DBERR_OK;
+        }
+        MappedFile file;
+        DB_STATUS ret = file.map(path);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        AprilIndex &aprilIndex = dataset->aprilIndex;
+        std::string key = uniform_grid::snapshot::getDatasetKey(dataset);
+        const Header* header = reinterpret_cast<const Header*>(file.data);
+        if (file.size < sizeof(Header) || memcmp(header->magic, APRIL_MAGIC, sizeof(APRIL_MAGIC)) != 0 || header->version != APRIL_VERSION) {
+            logger::log_warning("Ignoring invalid APRIL file", path);
+            return DBERR_OK;
+        }
+        size_t offset = sizeof(Header);
+        if (header->order != aprilIndex.order || header->xMinGlobal != aprilIndex.xMin || header->yMinGlobal != aprilIndex.yMin
+            || header->xMaxGlobal != aprilIndex.xMax || header->yMaxGlobal != aprilIndex.yMax || offset + header->keyLength > file.size
+            || key.empty() || key != std::string(file.data + offset, header->keyLength)) {
+            logger::log_warning("APRIL file is outdated for dataset", dataset->nickname);
+            return DBERR_OK;
+        }
+        offset += header->keyLength;
+        std::unordered_map<size_t, AprilData> objects;
+        objects.reserve(header->objectCount);
+        for (uint64_t i=0; i<header->objectCount; i++) {
+            uint64_t counts[3];
+            if (offset + sizeof(counts) > file.size) {
+                logger::log_warning("Ignoring truncated APRIL file", path);
+                return DBERR_OK;
+            }
+            memcpy(counts, file.data + offset, sizeof(counts));
+            offset += sizeof(counts);
+            if (counts[1] % 2 != 0 || counts[2] % 2 != 0 || offset + (counts[1] + counts[2]) * sizeof(uint32_t) > file.size) {
+                logger::log_warning("Ignoring truncated APRIL file", path);
+                return DBERR_OK;
+            }
+            AprilData &aprilData = objects[counts[0]];
+            aprilData.allIntervals.resize(counts[1]);
+            memcpy(aprilData.allIntervals.data(), file.data + offset, counts[1] * sizeof(uint32_t));
+            offset += counts[1] * sizeof(uint32_t);
+            aprilData.fullIntervals.resize(counts[2]);
+            memcpy(aprilData.fullIntervals.data(), file.data + offset, counts[2] * sizeof(uint32_t));
+            offset += counts[2] * sizeof(uint32_t);
+        }
+        aprilIndex.objects = std::move(objects);
+        loaded = true;
+        return DBERR_OK;
+    }
+
+    /** @brief Rasterizes all areal objects of the dataset in parallel. */
+    static DB_STATUS rasterizeDataset(Dataset* dataset) {
+        AprilIndex &aprilIndex = dataset->aprilIndex;
+        Grid grid(aprilIndex.order, g_config.datasetMetadata.dataspaceMetadata);
+        // create and link the entries first (so that materialized lazy shapes get them too), the threads fill in their own ones
+        std::vector<std::pair<Shape*, AprilData*>> objects;
+        for (auto &recID : dataset->objectIDs) {
+            Shape* object = dataset->getObject(recID);
+            if (object->isAreal()) {
+                object->aprilData = &aprilIndex.objects[recID];
+                objects.emplace_back(object, &aprilIndex.objects[recID]);
+            }
+        }
+        DB_STATUS ret = DBERR_OK;
+        #pragma omp parallel num_threads(std::max(1, g_config.getNumThreads()))
+        {
+            Rasterizer rasterizer(grid);
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t i=0; i<objects.size(); i++) {
+                // the full geometry (materialized for lazy shapes, without filling their cache)
+                std::shared_ptr<Shape> holder;
+                Shape* geometry = GeometryCache::getGeometry(objects[i].first, holder, false);
+                if (geometry == nullptr) {
+                    #pragma omp critical
+                    ret = DBERR_INVALID_GEOMETRY;
+                    continue;
+                }
+                rasterizer.rasterize(geometry, *objects[i].second);
+            }
+        }
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed to materialize the geometries of dataset", dataset->nickname);
+        }
+        return ret;
+    }
+
+    DB_STATUS build(Dataset* dataset) {
+        DB_STATUS ret = DBERR_OK;
+        int order = g_config.indexConfig.aprilOrder;
+        DataspaceMetadata &dataspace = g_config.datasetMetadata.dataspaceMetadata;
+        AprilIndex &aprilIndex = dataset->aprilIndex;
+        if (order == 0 || aprilIndex.isBuiltFor(order, dataspace)) {
+            return ret;
+        }
+        double startTime = omp_get_wtime();
+        aprilIndex.order = order;
+        aprilIndex.xMin = dataspace.xMinGlobal;
+        aprilIndex.yMin = dataspace.yMinGlobal;
+        aprilIndex.xMax = dataspace.xMaxGlobal;
+        aprilIndex.yMax = dataspace.yMaxGlobal;
+        aprilIndex.objects.clear();
+        // load from the APRIL directory, if stored there
+        bool loaded = false;
+        std::string path = "";
+        if (g_config.indexConfig.aprilDirectory != "") {
+            path = getAprilFilePath(dataset, order);
+            ret = load(path, dataset, loaded);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
+        if (!loaded) {
+            ret = rasterizeDataset(dataset);
+            if (ret != DBERR_OK) {
+                aprilIndex.order = 0;
+                return ret;
+            }
+        }
+        // link the approximations to the objects
+        size_t intervals = 0;
+        for (auto &recID : dataset->objectIDs) {
+            Shape* object = dataset->getObject(recID);
+            auto it = aprilIndex.objects.find(recID);
+            object->aprilData = (it != aprilIndex.objects.end()) ? &it->second : nullptr;
+            if (it != aprilIndex.objects.end()) {
+                intervals += (it->second.allIntervals.size() + it->second.fullIntervals.size()) / 2;
+            }
+        }
+        logger::log_success((loaded ? "Loaded" : "Built"), "the APRIL approximations of", aprilIndex.objects.size(), "objects of dataset", dataset->nickname, "in", omp_get_wtime() - startTime, "seconds, with", intervals, "intervals in total");
+        if (!loaded && path != "") {
+            ret = save(path, dataset);
+        }
+        return ret;
+    }
+
+    /** @brief Returns true if the interval lists have a common cell. */
+    static bool intersect(const std::vector<uint32_t> &intervalsA, const std::vector<uint32_t> &intervalsB) {
+        size_t i = 0, j = 0;
+        while (i < intervalsA.size() && j < intervalsB.size()) {
+            if (intervalsA[i+1] < intervalsB[j]) {
+                i += 2;
+            } else if (intervalsB[j+1] < intervalsA[i]) {
+                j += 2;
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** @brief Returns true if all cells of A are cells of B (the intervals of B are maximal, so each one of A is inside one of B). */
+    static bool isContained(const std::vector<uint32_t> &intervalsA, const std::vector<uint32_t> &intervalsB) {
+        size_t j = 0;
+        for (size_t i=0; i<intervalsA.size(); i+=2) {
+            while (j < intervalsB.size() && intervalsB[j+1] < intervalsA[i]) {
+                j += 2;
+            }
+            if (j >= intervalsB.size() || intervalsB[j] > intervalsA[i] || intervalsB[j+1] < intervalsA[i+1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @brief Returns true if the interiors of the objects intersect: a cell of one lies in the interior of the other. */
+    static inline bool interiorsIntersect(const AprilData* aprilR, const AprilData* aprilS) {
+        return intersect(aprilR->allIntervals, aprilS->fullIntervals) || intersect(aprilR->fullIntervals, aprilS->allIntervals);
+    }
+
+    bool filter(const AprilData* aprilR, const AprilData* aprilS, MBRRelationCase mbrRelationCase, TopologyRelation &relation) {
+        if (aprilR == nullptr || aprilS == nullptr || aprilR->allIntervals.empty() || aprilS->allIntervals.empty()) {
+            return false;
+        }
+        switch (mbrRelationCase) {
+            case MBR_R_IN_S:
+                if (!intersect(aprilR->allIntervals, aprilS->allIntervals)) {
+                    relation = TR_DISJOINT;
+                    return true;
+                }
+                if (isContained(aprilR->allIntervals, aprilS->fullIntervals)) {
+                    relation = TR_INSIDE;
+                    return true;
+                }
+                // R is not covered by S
+                if (!isContained(aprilR->allIntervals, aprilS->allIntervals) && interiorsIntersect(aprilR, aprilS)) {
+                    relation = TR_INTERSECT;
+                    return true;
+                }
+                return false;
+            case MBR_S_IN_R:
+                if (!intersect(aprilR->allIntervals, aprilS->allIntervals)) {
+                    relation = TR_DISJOINT;
+                    return true;
+                }
+                if (isContained(aprilS->allIntervals, aprilR->fullIntervals)) {
+                    relation = TR_CONTAINS;
+                    return true;
+                }
+                // S is not covered by R
+                if (!isContained(aprilS->allIntervals, aprilR->allIntervals) && interiorsIntersect(aprilR, aprilS)) {
+                    relation = TR_INTERSECT;
+                    return true;
+                }
+                return false;
+            case MBR_EQUAL:
+                // neither covers the other (refined as intersect even if they are disjoint)
+                if (!isContained(aprilR->allIntervals, aprilS->allIntervals) && !isContained(aprilS->allIntervals, aprilR->allIntervals)) {
+                    relation = TR_INTERSECT;
+                    return true;
+                }
+                return false;
+            case MBR_INTERSECT:
+                if (!intersect(aprilR->allIntervals, aprilS->allIntervals)) {
+                    relation = TR_DISJOINT;
+                    return true;
+                }
+                if (interiorsIntersect(aprilR, aprilS)) {
+                    relation = TR_INTERSECT;
+                    return true;
+                }
+                return false;
+            default:
+                return false;
+        }
+    }
+}
@@ -7,251 +7,430 @@ namespace uniform_grid
     }
 
     /**
-    @brief Calculates the intersecting partitions in the distribution grid for the given MBR.
-     * @param[in] xMin, yMin, xMax, yMax MBR
-     * @param[out] partitionIDs The partition IDs that intersect with the MBR.
+    @brief Calculates and sets the range of grid cells that the object's MBR intersects.
+     * For the quadtree, the cells of the 2^depth grid that its leaves are aligned to.
      */
-    static DB_STATUS getPartitionsForMBR(MBR &mbr, std::vector<int> &partitionIDs){
-        int minPartitionX = (mbr.pMin.x - g_config.datasetMetadata.dataspaceMetadata.xMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.xExtent / (double) g_config.indexConfig.partitionsPerDim);
-        int minPartitionY = (mbr.pMin.y - g_config.datasetMetadata.dataspaceMetadata.yMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.yExtent / (double) g_config.indexConfig.partitionsPerDim);
-        int maxPartitionX = (mbr.pMax.x - g_config.datasetMetadata.dataspaceMetadata.xMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.xExtent / (double) g_config.indexConfig.partitionsPerDim);
-        int maxPartitionY = (mbr.pMax.y - g_config.datasetMetadata.dataspaceMetadata.yMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.yExtent / (double) g_config.indexConfig.partitionsPerDim);
-        
-        int startPartitionID = getPartitionID(minPartitionX, minPartitionY, g_config.indexConfig.partitionsPerDim);
-        int lastPartitionID = getPartitionID(maxPartitionX, maxPartitionY, g_config.indexConfig.partitionsPerDim);
-        if (startPartitionID < 0 || startPartitionID > g_config.indexConfig.partitionsPerDim * g_config.indexConfig.partitionsPerDim -1) {
+    static DB_STATUS setCellRange(Shape &object) {
+        if (g_config.indexConfig.indexType == IT_QUADTREE) {
+            int minCellX, minCellY, maxCellX, maxCellY;
+            quadtree::getCellRange(object.mbr, minCellX, minCellY, maxCellX, maxCellY);
+            object.setCellRange(minCellX, minCellY, maxCellX, maxCellY);
+            return DBERR_OK;
+        }
+        DataspaceMetadata &dataspace = g_config.datasetMetadata.dataspaceMetadata;
+        int partitionsPerDim = g_config.indexConfig.partitionsPerDim;
+        int minCellX = (object.mbr.pMin.x - dataspace.xMinGlobal) / (dataspace.xExtent / (double) partitionsPerDim);
+        int minCellY = (object.mbr.pMin.y - dataspace.yMinGlobal) / (dataspace.yExtent / (double) partitionsPerDim);
+        int maxCellX = (object.mbr.pMax.x - dataspace.xMinGlobal) / (dataspace.xExtent / (double) partitionsPerDim);
+        int maxCellY = (object.mbr.pMax.y - dataspace.yMinGlobal) / (dataspace.yExtent / (double) partitionsPerDim);
+        if (minCellX < 0 || minCellY < 0 || minCellX >= partitionsPerDim || minCellY >= partitionsPerDim) {
             logger::log_error(DBERR_INVALID_PARTITION, "Start partition ID calculated wrong");
             return DBERR_INVALID_PARTITION;
         }
-        if (lastPartitionID < 0 || lastPartitionID > g_config.indexConfig.partitionsPerDim * g_config.indexConfig.partitionsPerDim -1) {
-            logger::log_error(DBERR_INVALID_PARTITION, "Last partition ID calculated wrong: MBR(", mbr.pMin.x, mbr.pMin.y, mbr.pMax.x, mbr.pMax.y, ")");
+        if (maxCellX < minCellX || maxCellY < minCellY || maxCellX >= partitionsPerDim || maxCellY >= partitionsPerDim) {
+            logger::log_error(DBERR_INVALID_PARTITION, "Last partition ID calculated wrong: MBR(", object.mbr.pMin.x, object.mbr.pMin.y, object.mbr.pMax.x, object.mbr.pMax.y, ")");
             return DBERR_INVALID_PARTITION;
         }
-        // create the distribution grid partition list for the object
-        partitionIDs.reserve((maxPartitionX - minPartitionX) * (maxPartitionY - minPartitionY));
-        for (int i=minPartitionX; i<=maxPartitionX; i++) {
-            for (int j=minPartitionY; j<=maxPartitionY; j++) {
-                int partitionID = getPartitionID(i, j, g_config.indexConfig.partitionsPerDim);
-                partitionIDs.emplace_back(partitionID);
-            }
-        }
+        object.setCellRange(minCellX, minCellY, maxCellX, maxCellY);
         return DBERR_OK;
     }
 
-    static DB_STATUS calculateDataspaceBounds(Dataset* dataset) {
-        DB_STATUS ret = DBERR_OK;
-        // open file
-        std::ifstream fin(dataset->path);
+    /** @brief Returns the path of the dataspace bounds sidecar file of the dataset. */
+    static std::string getBoundsSidecarPath(Dataset* dataset) {
+        return dataset->path + ".bounds";
+    }
+
+    /** @brief Returns the key that ties a bounds sidecar to the current state of the dataset file (empty if it cannot be read). */
+    static std::string getBoundsSidecarKey(Dataset* dataset) {
+        struct stat st;
+        if (stat(dataset->path.c_str(), &st) != 0) {
+            return "";
+        }
+        return std::to_string(st.st_size) + " " + std::to_string(st.st_mtime) + " " + std::to_string(dataset->wktColIdx);
+    }
+
+    /**
+    @brief Sets the dataset's dataspace bounds from its bounds sidecar file, if one exists and is up to date.
+     * @return true if the bounds were set.
+     */
+    static bool loadBoundsSidecar(Dataset* dataset) {
+        std::ifstream fin(getBoundsSidecarPath(dataset));
         if (!fin.is_open()) {
-            logger::log_error(DBERR_FILE_OPEN, "Failed to open dataset path:", dataset->path);
+            return false;
+        }
+        std::string key;
+        std::string currentKey = getBoundsSidecarKey(dataset);
+        if (currentKey.empty() || !std::getline(fin, key) || key != currentKey) {
+            logger::log_warning("Ignoring outdated bounds sidecar for dataset", dataset->nickname);
+            return false;
+        }
+        double xMin, yMin, xMax, yMax;
+        if (!(fin >> xMin >> yMin >> xMax >> yMax)) {
+            logger::log_warning("Ignoring malformed bounds sidecar for dataset", dataset->nickname);
+            return false;
+        }
+        dataset->dataspaceMetadata.set(xMin, yMin, xMax, yMax);
+        return true;
+    }
+
+    /** @brief Stores the dataset's (unadjusted) dataspace bounds in its bounds sidecar file. */
+    static DB_STATUS writeBoundsSidecar(Dataset* dataset, double xMin, double yMin, double xMax, double yMax) {
+        std::string key = getBoundsSidecarKey(dataset);
+        if (key.empty()) {
+            logger::log_error(DBERR_FILE_OPEN, "Failed to stat dataset file:", dataset->path);
+            return DBERR_FILE_OPEN;
+        }
+        std::ofstream fout(getBoundsSidecarPath(dataset), std::ofstream::out);
+        if (!fout.is_open()) {
+            logger::log_error(DBERR_FILE_OPEN, "Failed to open bounds sidecar file:", getBoundsSidecarPath(dataset));
             return DBERR_FILE_OPEN;
         }
-        std::string line;
+        fout << key << std::endl;
+        fout << std::setprecision(17) << xMin << " " << yMin << " " << xMax << " " << yMax << std::endl;
+        if (!fout) {
+            logger::log_error(DBERR_FILE_WRITE, "Failed to write bounds sidecar file:", getBoundsSidecarPath(dataset));
+            return DBERR_FILE_WRITE;
+        }
+        return DBERR_OK;
+    }
+
+    /** @brief Calculates the dataset's dataspace bounds from the MBRs of its loaded objects. */
+    static DB_STATUS calculateDataspaceBounds(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
+        DB_STATUS ret = DBERR_OK;
         double global_xMin = std::numeric_limits<int>::max();
         double global_yMin = std::numeric_limits<int>::max();
         double global_xMax = -std::numeric_limits<int>::max();
         double global_yMax = -std::numeric_limits<int>::max();
-        size_t lineCounter = 0;
-        size_t totalValidObjects = 0;
-
-        // shape created
-        std::string token;
-        std::string wktData;
-        // loop lines
-        while (std::getline(fin, line)) {     
-            // parse line
-            std::stringstream ss(line);
-            int currentCol = -1;
-            // get the wkt data
-            while (currentCol < dataset->wktColIdx) {
-                std::getline(ss, token, '\t');
-                currentCol++;
-            }
-            wktData = token;
-            // get data type
-            std::stringstream typess(wktData);
-            std::getline(typess, token, '(');
-            DataType datatype = mapping::dataTypeTextToInt(token);
-            // create object
-            Shape object;
-            ret = shape_factory::createEmpty(datatype, object);
-            if (ret != DBERR_OK) {
-                // error creating shape
-                logger::log_error(ret, "Failed while creating empty shape of data type", mapping::dataTypeIntToStr(datatype));
-                return ret;
-            }
-            // set object from the WKT
-            ret = object.setFromWKT(wktData);
-            if (ret == DBERR_INVALID_GEOMETRY) {
-                // this line is not the appropriate geometry type, so just ignore
-                ret = DBERR_OK;
-            } else if (ret != DBERR_OK) {
-                // some other error occured, interrupt
-                logger::log_error(ret, "Setting object shape from WKT failed.");
-                return ret;
-            } else {
-                // valid object
-                totalValidObjects += 1;
-                // set the MBR
-                object.setMBR();
-                // set dataspace bounds
+        for (auto &chunk : chunkObjects) {
+            for (auto &object : chunk) {
                 global_xMin = std::min(global_xMin, object.mbr.pMin.x);
                 global_yMin = std::min(global_yMin, object.mbr.pMin.y);
                 global_xMax = std::max(global_xMax, object.mbr.pMax.x);
                 global_yMax = std::max(global_yMax, object.mbr.pMax.y);
-                
             }
-            lineCounter += 1;
         }
         // update dataset dataspace
         dataset->dataspaceMetadata.set(global_xMin, global_yMin, global_xMax, global_yMax);
-        // close file
-        fin.close();
-        
+        if (g_config.indexConfig.useBoundsSidecar) {
+            ret = writeBoundsSidecar(dataset, global_xMin, global_yMin, global_xMax, global_yMax);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
         return ret;
     }
 
-    // todo: make parallel
-    static DB_STATUS indexDataset(Dataset* dataset) {
+    /**
+    @brief Assigns the loaded objects to the grid partitions and inserts them into the index. 
+     * Cell ranges are calculated in parallel (per chunk), insertion happens in file order. 
+     * The chunks are emptied in the process.
+     * @warning The global dataspace bounds must be set.
+     */
+    static DB_STATUS indexDataset(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
         DB_STATUS ret = DBERR_OK;
-        
-        // open file
-        std::ifstream fin(dataset->path);
-        if (!fin.is_open()) {
-            logger::log_error(DBERR_FILE_OPEN, "Failed to open dataset path:", dataset->path);
-            return DBERR_FILE_OPEN;
+        int numChunks = chunkObjects.size();
+        std::vector<DB_STATUS> chunkRet(numChunks, DBERR_OK);
+
+        #pragma omp parallel for num_threads(std::max(1, g_config.getNumThreads())) schedule(static, 1)
+        for (int c=0; c<numChunks; c++) {
+            for (auto &object : chunkObjects[c]) {
+                // calculate the cell range
+                DB_STATUS local_ret = setCellRange(object);
+                if (local_ret != DBERR_OK) {
+                    chunkRet[c] = local_ret;
+                    break;
+                }
+            }
         }
-        std::string line;
-        // count how many batches have been sent in total
-        int partitionID;
-        size_t lineCounter = 0;
-        size_t totalValidObjects = 0;
-        
-        // shape created
-        std::string token;
-        std::string wktData;
-        // loop lines (todo: first count lines, then make parallel load)
-        while (std::getline(fin, line)) {
-            // parse line
-            std::stringstream ss(line);
-            std::vector<std::string> tokens;
-            ret = splitString(line, '\t', tokens);
-            if (ret != DBERR_OK) {
-                logger::log_error(ret, "Split data line failed.");
-                return ret;
+        for (auto &it : chunkRet) {
+            if (it != DBERR_OK) {
+                return it;
             }
+        }
 
-            int currentCol = -1;
-            // get the wkt data
-            while (currentCol < dataset->wktColIdx) {
-                std::getline(ss, token, '\t');
-                currentCol++;
+        // add to index in file order
+        for (auto &chunk : chunkObjects) {
+            for (auto &object : chunk) {
+                ret = dataset->addObject(object);
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
             }
-            if (dataset->wktColIdx < tokens.size()) {
-                wktData = tokens[dataset->wktColIdx];
-            } else {
-                logger::log_error(DBERR_INVALID_PARAMETER, "Invalid wkt column index for dataset. Value:", dataset->wktColIdx, "while the line has only", tokens.size(), "columns.");
-                return DBERR_INVALID_PARAMETER;
+            // release the chunk's memory early
+            std::vector<Shape>().swap(chunk);
+        }
+        chunkObjects.clear();
+
+        return ret;
+    }
+
+    /** @brief Stores the loaded objects in the dataset in file order, without partitions. The chunks are emptied in the process. */
+    static DB_STATUS storeObjects(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
+        DB_STATUS ret = DBERR_OK;
+        for (auto &chunk : chunkObjects) {
+            for (auto &object : chunk) {
+                object.clearCellRange();
+                ret = dataset->addObject(object);
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
             }
-            // get data type
-            std::string datatypeStr;
-            std::stringstream typess(wktData);
-            std::getline(typess, datatypeStr, '(');
-            DataType datatype = mapping::dataTypeTextToInt(datatypeStr);
-            // create object
-            Shape object;
-            ret = shape_factory::createEmpty(datatype, object);
+            // release the chunk's memory early
+            std::vector<Shape>().swap(chunk);
+        }
+        chunkObjects.clear();
+        return ret;
+    }
+
+    /** @brief Stores the loaded objects of the dataset and bulk-loads its R-tree. */
+    static DB_STATUS indexDatasetRTree(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
+        DB_STATUS ret = storeObjects(dataset, chunkObjects);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        ret = rtree::build(dataset);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while building the R-tree of dataset", dataset->nickname);
+        }
+        return ret;
+    }
+
+    /** @brief Loads the datasets R and S (all S datasets of a multi-way join) from their files and indexes them. In self-joins S aliases R and is not loaded again. */
+    static DB_STATUS build() {
+        DB_STATUS ret = DBERR_OK;
+        Dataset* R = g_config.datasetMetadata.getDatasetR();
+        std::vector<Dataset*> &datasetsS = g_config.datasetMetadata.getDatasetsS();
+        bool aliased = (datasetsS.size() == 1 && datasetsS.front() == R);
+        // the S datasets to load (none if S aliases R)
+        size_t countS = aliased ? 0 : datasetsS.size();
+        std::vector<std::vector<Shape>> chunkObjectsR;
+        std::vector<std::vector<std::vector<Shape>>> chunkObjectsS(countS);
+
+        // if all datasets have up to date bounds sidecars, the global dataspace is known before loading
+        // (the quadtree needs the objects of all datasets, so R can not be indexed early then)
+        bool boundsKnown = false;
+        if (g_config.indexConfig.useBoundsSidecar && g_config.indexConfig.indexType == IT_UNIFORM_GRID) {
+            boundsKnown = loadBoundsSidecar(R);
+            for (size_t i=0; i<countS && boundsKnown; i++) {
+                boundsKnown = loadBoundsSidecar(datasetsS[i]);
+            }
+            if (boundsKnown) {
+                g_config.datasetMetadata.updateDataspace();
+                logger::log_success("Loaded dataspace bounds from the bounds sidecar files.");
+            }
+        }
+
+        // load dataset R
+        ret = loader::loadDataset(R, chunkObjectsR);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while loading dataset", R->nickname);
+            return ret;
+        }
+        if (boundsKnown) {
+            // index R right away, so that its chunks are released before S is loaded
+            ret = indexDataset(R, chunkObjectsR);
             if (ret != DBERR_OK) {
-                // error creating shape
-                logger::log_error(ret, "Failed while creating empty shape of data type", mapping::dataTypeIntToStr(datatype));
+                logger::log_error(ret, "Failed while indexing dataset", R->nickname);
                 return ret;
             }
-            // get the name of the entity
-            if (dataset->nameColIdx < tokens.size()) {
-                object.name = tokens[dataset->nameColIdx];
-            } else {
-                logger::log_error(DBERR_INVALID_PARAMETER, "Invalid wkt column index for dataset. Value:", dataset->wktColIdx, "while the line has only", tokens.size(), "columns.");
-                return DBERR_INVALID_PARAMETER;
+        } else {
+            ret = calculateDataspaceBounds(R, chunkObjectsR);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed calculating dataspace bounds for dataset", R->nickname);
+                return ret;
             }
-            // add as object name the dataset type (if set) + object name
-            if (dataset->description != "") {
-                object.name = dataset->description + " " + object.name;
+        }
+
+        // load the S datasets
+        for (size_t i=0; i<countS; i++) {
+            Dataset* S = datasetsS[i];
+            ret = loader::loadDataset(S, chunkObjectsS[i]);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while loading dataset", S->nickname);
+                return ret;
             }
-            // get any other column to modify the name with
-            if (dataset->otherColIdx != -1){
-                if(dataset->otherColIdx < tokens.size()) {
-                    int stateFP = std::stoi(tokens[dataset->otherColIdx]);
-                    object.name += ", " + state::stateFpToStateName(stateFP);
-                } else {
-                    logger::log_error(DBERR_INVALID_PARAMETER, "Invalid other column index for dataset. Value:", dataset->otherColIdx, "while the line has only", tokens.size(), "columns.");
-                    return DBERR_INVALID_PARAMETER;
+            if (boundsKnown) {
+                // index S right away too, before the next S is loaded
+                ret = indexDataset(S, chunkObjectsS[i]);
+                if (ret != DBERR_OK) {
+                    logger::log_error(ret, "Failed while indexing dataset", S->nickname);
+                    return ret;
+                }
+            } else {
+                ret = calculateDataspaceBounds(S, chunkObjectsS[i]);
+                if (ret != DBERR_OK) {
+                    logger::log_error(ret, "Failed calculating dataspace bounds for dataset", S->nickname);
+                    return ret;
                 }
             }
-
-            // set rec ID
-            object.recID = lineCounter;
-            // set object from the WKT
-            ret = object.setFromWKT(wktData);
-            if (ret == DBERR_INVALID_GEOMETRY) {
-                // this line is not the appropriate geometry type, so just ignore
-                ret = DBERR_OK;
-            } else if (ret != DBERR_OK) {
-                // some other error occured, interrupt
+        }
+        if (!boundsKnown) {
+            g_config.datasetMetadata.updateDataspace();
+            if (g_config.indexConfig.indexType == IT_RTREE) {
+                // each dataset is packed into its own R-tree, independently of the global dataspace
+                ret = indexDatasetRTree(R, chunkObjectsR);
+                for (size_t i=0; i<countS && ret == DBERR_OK; i++) {
+                    ret = indexDatasetRTree(datasetsS[i], chunkObjectsS[i]);
+                }
                 return ret;
-            } else {
-                // valid object
-                totalValidObjects += 1;
-                // set the MBR
-                object.setMBR();
-                // calculate partitions
-                std::vector<int> partitionIDs;
-                ret = getPartitionsForMBR(object.mbr, partitionIDs);
+            }
+            if (g_config.indexConfig.indexType == IT_QUADTREE) {
+                std::vector<std::vector<std::vector<Shape>>*> allChunkObjects = {&chunkObjectsR};
+                for (auto &chunkObjects : chunkObjectsS) {
+                    allChunkObjects.emplace_back(&chunkObjects);
+                }
+                if (aliased) {
+                    // in self-joins R's objects are counted for S too, so that the tree matches the unshared one
+                    allChunkObjects.emplace_back(&chunkObjectsR);
+                }
+                std::vector<MBR*> mbrs;
+                for (auto chunkObjects : allChunkObjects) {
+                    for (auto &chunk : *chunkObjects) {
+                        for (auto &object : chunk) {
+                            mbrs.emplace_back(&object.mbr);
+                        }
+                    }
+                }
+                ret = quadtree::build(mbrs);
                 if (ret != DBERR_OK) {
+                    logger::log_error(ret, "Failed while building the quadtree.");
                     return ret;
                 }
-                object.setPartitions(partitionIDs, partitionIDs.size());
-                // add to index
-                dataset->addObject(object);
             }
-            lineCounter += 1;
+            // index dataset R
+            ret = indexDataset(R, chunkObjectsR);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while indexing dataset", R->nickname);
+                return ret;
+            }
+        }
+        logger::log_success("Global dataspace bounds:", g_config.datasetMetadata.dataspaceMetadata.xMinGlobal, g_config.datasetMetadata.dataspaceMetadata.yMinGlobal, g_config.datasetMetadata.dataspaceMetadata.xMaxGlobal, g_config.datasetMetadata.dataspaceMetadata.yMaxGlobal);
+
+        if (boundsKnown) {
+            return ret;
+        }
+        // index the S datasets
+        for (size_t i=0; i<countS; i++) {
+            ret = indexDataset(datasetsS[i], chunkObjectsS[i]);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while indexing dataset", datasetsS[i]->nickname);
+                return ret;
+            }
         }
-        // close file
-        fin.close();
 
         return ret;
     }
 
-    DB_STATUS create() {
+    DB_STATUS loadObjects(Dataset* dataset) {
         DB_STATUS ret = DBERR_OK;
-
-        // calculate dataspace bounds
-        ret = calculateDataspaceBounds(g_config.datasetMetadata.getDatasetR());
+        std::vector<std::vector<Shape>> chunkObjects;
+        ret = loader::loadDataset(dataset, chunkObjects);
         if (ret != DBERR_OK) {
-            logger::log_error(ret, "Failed calculating dataspace bounds for dataset", g_config.datasetMetadata.getDatasetR()->nickname);
+            logger::log_error(ret, "Failed while loading dataset", dataset->nickname);
             return ret;
         }
-        ret = calculateDataspaceBounds(g_config.datasetMetadata.getDatasetS());
+        ret = calculateDataspaceBounds(dataset, chunkObjects);
         if (ret != DBERR_OK) {
-            logger::log_error(ret, "Failed calculating dataspace bounds for dataset", g_config.datasetMetadata.getDatasetS()->nickname);
+            logger::log_error(ret, "Failed calculating dataspace bounds for dataset", dataset->nickname);
             return ret;
         }
-        g_config.datasetMetadata.updateDataspace();
-        logger::log_success("Global dataspace bounds:", g_config.datasetMetadata.dataspaceMetadata.xMinGlobal, g_config.datasetMetadata.dataspaceMetadata.yMinGlobal, g_config.datasetMetadata.dataspaceMetadata.xMaxGlobal, g_config.datasetMetadata.dataspaceMetadata.yMaxGlobal);
+        // store the objects in file order, without partitions
+        return storeObjects(dataset, chunkObjects);
+    }
 
-        // index dataset R
-        ret = uniform_grid::indexDataset(g_config.datasetMetadata.getDatasetR());
+    DB_STATUS reindex(Dataset* dataset) {
+        // drop the previous index
+        dataset->uniformGridIndex.clear();
+        std::vector<Shape*> objects;
+        objects.reserve(dataset->objectIDs.size());
+        for (auto &recID : dataset->objectIDs) {
+            objects.emplace_back(dataset->getObject(recID));
+        }
+        // calculate the cell ranges in parallel
+        DB_STATUS ret = DBERR_OK;
+        #pragma omp parallel for num_threads(std::max(1, g_config.getNumThreads()))
+        for (size_t i=0; i<objects.size(); i++) {
+            DB_STATUS local_ret = setCellRange(*objects[i]);
+            if (local_ret != DBERR_OK) {
+                #pragma omp critical
+                ret = local_ret;
+            }
+        }
         if (ret != DBERR_OK) {
-            logger::log_error(ret, "Failed while indexing dataset", g_config.datasetMetadata.getDatasetS()->nickname);
+            logger::log_error(ret, "Failed while indexing dataset", dataset->nickname);
             return ret;
         }
+        // add to index in file order
+        for (auto &object : objects) {
+            ret = dataset->uniformGridIndex.addObject(object);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while indexing dataset", dataset->nickname);
+                return ret;
+            }
+        }
+        dataset->uniformGridIndex.sortPartitions();
+        return ret;
+    }
 
-        // index dataset S
-        ret = uniform_grid::indexDataset(g_config.datasetMetadata.getDatasetS());
+    DB_STATUS buildQuadtree(Dataset* R, Dataset* S) {
+        std::vector<MBR*> mbrs;
+        for (Dataset* dataset : {R, S}) {
+            for (auto &recID : dataset->objectIDs) {
+                mbrs.emplace_back(&dataset->getObject(recID)->mbr);
+            }
+        }
+        DB_STATUS ret = quadtree::build(mbrs);
         if (ret != DBERR_OK) {
-            logger::log_error(ret, "Failed while indexing dataset", g_config.datasetMetadata.getDatasetS()->nickname);
-            return ret;
+            logger::log_error(ret, "Failed while building the quadtree.");
         }
+        return ret;
+    }
 
+    DB_STATUS create() {
+        DB_STATUS ret = DBERR_OK;
+        bool loaded = false;
+        // try the index snapshot first
+        if (g_config.indexConfig.loadIndexPath != "") {
+            ret = snapshot::load(g_config.indexConfig.loadIndexPath, loaded);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while loading the index snapshot.");
+                return ret;
+            }
+        }
+        if (!loaded) {
+            ret = build();
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
+        // sort the partitions' contents for the plane sweep join
+        g_config.datasetMetadata.getDatasetR()->uniformGridIndex.sortPartitions();
+        for (Dataset* S : g_config.datasetMetadata.getDatasetsS()) {
+            if (S != g_config.datasetMetadata.getDatasetR()) {
+                S->uniformGridIndex.sortPartitions();
+            }
+        }
+        // the APRIL approximations for the intermediate filter (on the global dataspace)
+        ret = april::build(g_config.datasetMetadata.getDatasetR());
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while building the APRIL approximations.");
+            return ret;
+        }
+        for (Dataset* S : g_config.datasetMetadata.getDatasetsS()) {
+            ret = april::build(S);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while building the APRIL approximations.");
+                return ret;
+            }
+        }
+        // store the index, unless it was just loaded from the same snapshot
+        if (g_config.indexConfig.saveIndexPath != "" && !(loaded && g_config.indexConfig.saveIndexPath == g_config.indexConfig.loadIndexPath)) {
+            ret = snapshot::save(g_config.indexConfig.saveIndexPath);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while saving the index snapshot.");
+                return ret;
+            }
+        }
         return ret;
     }
 }
@@ -1,7 +1,343 @@
 #include "index/filter.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace uniform_grid
 {      
+    /**
+    @brief The two-layer class pairs (R x S) that are joined in each common partition.
+     * A pair of objects is reported only in the partition that contains the bottom-left corner of their MBRs' 
+     * intersection, i.e. where at least one of them starts in x and at least one starts in y. The excluded 
+     * pairs (B-B, B-D, C-C, C-D, D-B, D-C, D-D) are reported in an earlier partition that both objects intersect.
+     */
+    static const std::pair<TwoLayerClass, TwoLayerClass> CLASS_PAIRS[] = {
+        {CLASS_A, CLASS_A}, {CLASS_A, CLASS_B}, {CLASS_A, CLASS_C}, {CLASS_A, CLASS_D},
+        {CLASS_B, CLASS_A}, {CLASS_B, CLASS_C},
+        {CLASS_C, CLASS_A}, {CLASS_C, CLASS_B},
+        {CLASS_D, CLASS_A},
+    };
+
+    /** @brief Class lists with fewer candidate pairs than this are joined with a nested loop instead of a plane sweep. */
+    static const size_t SWEEP_MIN_PAIRS = 64;
+
+    /** @brief Partitions that cost more than 1/(threads * SPLIT_TASKS_PER_THREAD) of the whole join are split into tasks. */
+    static const int SPLIT_TASKS_PER_THREAD = 8;
+
+    /**
+    @brief A unit of work of the evaluation: a block of the R objects of a common partition, joined against all
+     * of its S objects. Each R class list is split into blockCount equal ranges and the task joins range 'block'.
+     * The blocks hold disjoint R objects, so the class-based deduplication still reports each pair once.
+     * In a multi-way join the block is joined against the partition of the same cell in every S dataset
+     * (partitionsS[i] for dataset i, nullptr where it is empty), so R's objects are visited once for all of them.
+     */
+    struct JoinTask {
+        Partition* partitionR;
+        Partition** partitionsS;
+        int countS;
+        int block;
+        int blockCount;
+        double cost;
+    };
+
+    /** @brief Calculates the positions [begin, end) of the block of a list of 'size' objects. */
+    static inline void getBlockRange(size_t size, int block, int blockCount, size_t &begin, size_t &end) {
+        begin = size * block / blockCount;
+        end = size * (block + 1) / blockCount;
+    }
+
+    /** @brief Returns the number of leading values that are not above the limit (scalar version). */
+    static inline size_t countNotAboveScalar(const double* values, size_t count, double limit) {
+        size_t k = 0;
+        while (k < count && values[k] <= limit) {
+            k++;
+        }
+        return k;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    /** @brief Returns the number of leading values that are not above the limit, comparing 4 values at a time (AVX2). */
+    __attribute__((target("avx2")))
+    static size_t countNotAboveAVX2(const double* values, size_t count, double limit) {
+        __m256d limits = _mm256_set1_pd(limit);
+        size_t k = 0;
+        for (; k + 4 <= count; k += 4) {
+            // 'not less or equal' (true for NaN too, like the scalar loop's stop condition)
+            int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + k), limits, _CMP_NLE_UQ));
+            if (mask != 0) {
+                return k + __builtin_ctz(mask);
+            }
+        }
+        return k + countNotAboveScalar(values + k, count - k, limit);
+    }
+
+    static inline bool hasAVX2() {
+        static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+        return supported;
+    }
+#endif
+
+    /** @brief Returns the number of leading values that are not above the limit. Uses AVX2 if the CPU supports it. */
+    static inline size_t countNotAbove(const double* values, size_t count, double limit) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (hasAVX2()) {
+            return countNotAboveAVX2(values, count, limit);
+        }
+#endif
+        return countNotAboveScalar(values, count, limit);
+    }
+
+    /** @brief The MBR of an object, tested against the MBR arrays of a class list. */
+    struct QueryMBR {
+        double xMin, yMin, xMax, yMax;
+
+        QueryMBR(ClassContents &contents, size_t i) : xMin(contents.xMin[i]), yMin(contents.yMin[i]), xMax(contents.xMax[i]), yMax(contents.yMax[i]) {}
+    };
+
+    /** @brief Calls overlapFunc(k) for each position k in [begin, end) of the list whose MBR intersects the query MBR (scalar version). */
+    template <typename OverlapFunction>
+    static inline DB_STATUS forEachOverlapScalar(ClassContents &contents, size_t begin, size_t end, const QueryMBR &query, OverlapFunction overlapFunc) {
+        DB_STATUS ret = DBERR_OK;
+        for (size_t k=begin; k<end; k++) {
+            if (contents.xMin[k] <= query.xMax && contents.xMax[k] >= query.xMin && contents.yMin[k] <= query.yMax && contents.yMax[k] >= query.yMin) {
+                ret = overlapFunc(k);
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
+            }
+        }
+        return ret;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    /** @brief Calls overlapFunc(k) for each position k in [begin, end) of the list whose MBR intersects the query MBR, testing 4 MBRs at a time (AVX2). */
+    template <typename OverlapFunction>
+    __attribute__((target("avx2")))
+    static DB_STATUS forEachOverlapAVX2(ClassContents &contents, size_t begin, size_t end, const QueryMBR &query, OverlapFunction overlapFunc) {
+        DB_STATUS ret = DBERR_OK;
+        __m256d queryXMin = _mm256_set1_pd(query.xMin);
+        __m256d queryYMin = _mm256_set1_pd(query.yMin);
+        __m256d queryXMax = _mm256_set1_pd(query.xMax);
+        __m256d queryYMax = _mm256_set1_pd(query.yMax);
+        size_t k = begin;
+        for (; k + 4 <= end; k += 4) {
+            __m256d overlap = _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(contents.xMin.data() + k), queryXMax, _CMP_LE_OQ),
+                                            _mm256_cmp_pd(_mm256_loadu_pd(contents.xMax.data() + k), queryXMin, _CMP_GE_OQ));
+            overlap = _mm256_and_pd(overlap, _mm256_cmp_pd(_mm256_loadu_pd(contents.yMin.data() + k), queryYMax, _CMP_LE_OQ));
+            overlap = _mm256_and_pd(overlap, _mm256_cmp_pd(_mm256_loadu_pd(contents.yMax.data() + k), queryYMin, _CMP_GE_OQ));
+            int mask = _mm256_movemask_pd(overlap);
+            while (mask != 0) {
+                ret = overlapFunc(k + __builtin_ctz(mask));
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return forEachOverlapScalar(contents, k, end, query, overlapFunc);
+    }
+#endif
+
+    /**
+    @brief Calls overlapFunc(k) for each position k in [begin, end) of the list whose MBR intersects the query MBR 
+     * (touching ones included). Uses AVX2 if the CPU supports it.
+     */
+    template <typename OverlapFunction>
+    static inline DB_STATUS forEachOverlap(ClassContents &contents, size_t begin, size_t end, const QueryMBR &query, OverlapFunction overlapFunc) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (hasAVX2()) {
+            return forEachOverlapAVX2(contents, begin, end, query, overlapFunc);
+        }
+#endif
+        return forEachOverlapScalar(contents, begin, end, query, overlapFunc);
+    }
+
+    /**
+    @brief Calls relateFunc(r, s) for each pair of objects of the two class lists whose MBRs intersect.
+     * Only these pairs are candidates, with every index type: objects with disjoint MBRs that happen to share a 
+     * grid cell are not related, so the generated documents do not depend on the index or its granularity.
+     * Both lists must be sorted by MBR bottom-left y (see UniformGridIndex::sortPartitions).
+     * Forward-scan plane sweep: the object with the lowest y is taken from either list and scanned against the
+     * objects of the other list that start below its top, whose MBRs are then tested against its MBR 
+     * (see forEachOverlap). The scan and the test run on the lists' MBR arrays, so only the related objects 
+     * are dereferenced. Small lists are joined with a nested loop.
+     * Only the R objects at positions [rBegin, rEnd) are joined, so that the R list can be split into blocks.
+     */
+    template <typename RelateFunction>
+    static inline DB_STATUS sweepJoin(ClassContents &contentsR, size_t rBegin, size_t rEnd, ClassContents &contentsS, RelateFunction relateFunc) {
+        DB_STATUS ret = DBERR_OK;
+        size_t sizeR = rEnd;
+        size_t sizeS = contentsS.size();
+        if ((rEnd - rBegin) * sizeS < SWEEP_MIN_PAIRS) {
+            for (size_t i=rBegin; i<sizeR; i++) {
+                ret = forEachOverlap(contentsS, 0, sizeS, QueryMBR(contentsR, i), [&](size_t k) {
+                    return relateFunc(contentsR.objects[i], contentsS.objects[k]);
+                });
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
+            }
+            return ret;
+        }
+        size_t i = rBegin;
+        size_t j = 0;
+        while (i < sizeR && j < sizeS) {
+            if (contentsR.yMin[i] < contentsS.yMin[j]) {
+                size_t last = j + countNotAbove(contentsS.yMin.data() + j, sizeS - j, contentsR.yMax[i]);
+                ret = forEachOverlap(contentsS, j, last, QueryMBR(contentsR, i), [&](size_t k) {
+                    return relateFunc(contentsR.objects[i], contentsS.objects[k]);
+                });
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
+                i++;
+            } else {
+                size_t last = i + countNotAbove(contentsR.yMin.data() + i, sizeR - i, contentsS.yMax[j]);
+                ret = forEachOverlap(contentsR, i, last, QueryMBR(contentsS, j), [&](size_t k) {
+                    return relateFunc(contentsR.objects[k], contentsS.objects[j]);
+                });
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
+                j++;
+            }
+        }
+        return ret;
+    }
+
+    /**
+    @brief Finds the partitions of R that are non-empty in at least one of the S datasets. For the k-th of them,
+     * partitionsS[k * countS + i] is the partition of the same cell in S dataset i (nullptr if it is empty there).
+     */
+    static DB_STATUS getCommonPartitions(Dataset* R, std::vector<Dataset*> &datasetsS, std::vector<Partition*> &partitionsR, std::vector<Partition*> &partitionsS) {
+        size_t countS = datasetsS.size();
+        // the position of each partition of R in partitionsR (-1 if it has no common partition yet)
+        std::vector<int32_t> positions(R->uniformGridIndex.partitions.size(), -1);
+        std::vector<std::pair<Partition*, Partition*>> commonPartitions;
+        partitionsR.clear();
+        partitionsS.clear();
+        for (size_t i=0; i<countS; i++) {
+            DB_STATUS ret = R->uniformGridIndex.getCommonPartitions(datasetsS[i]->uniformGridIndex, commonPartitions);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+            for (auto &pair : commonPartitions) {
+                int32_t &position = positions[pair.first - R->uniformGridIndex.partitions.data()];
+                if (position < 0) {
+                    position = partitionsR.size();
+                    partitionsR.emplace_back(pair.first);
+                    partitionsS.resize(partitionsS.size() + countS, nullptr);
+                }
+                partitionsS[position * countS + i] = pair.second;
+            }
+        }
+        return DBERR_OK;
+    }
+
+    /**
+    @brief Estimates the cost of joining a partition of R with its common partitions of the S datasets: the candidate 
+     * pairs of the joined class pairs, weighted by the average vertex count of the partitions' objects (refinement cost per pair).
+     */
+    static double estimateJoinCost(Partition* partitionR, Partition** partitionsS, int countS) {
+        double candidates = 0;
+        for (int i=0; i<countS; i++) {
+            if (partitionsS[i] == nullptr) {
+                continue;
+            }
+            for (auto &classPair : CLASS_PAIRS) {
+                candidates += partitionR->getContents(classPair.first)->size() * (double) partitionsS[i]->getContents(classPair.second)->size();
+            }
+        }
+        if (candidates == 0) {
+            return 0;
+        }
+        double vertices = 0;
+        size_t objects = 0;
+        std::vector<Partition*> partitions = {partitionR};
+        for (int i=0; i<countS; i++) {
+            if (partitionsS[i] != nullptr) {
+                partitions.emplace_back(partitionsS[i]);
+            }
+        }
+        for (Partition* partition : partitions) {
+            for (auto &contents : partition->classIndex) {
+                for (auto &object : contents.objects) {
+                    vertices += object->getVertexCount();
+                }
+                objects += contents.size();
+            }
+        }
+        return candidates * (1 + vertices / objects);
+    }
+
+    /**
+    @brief Creates the join tasks of the common partitions, most expensive first.
+     * With multiple threads, a partition whose estimated cost exceeds a fair share of the total is split
+     * into blocks of its R objects, each joined against all of its S objects as a separate task.
+     */
+    static void createJoinTasks(std::vector<Partition*> &partitionsR, std::vector<Partition*> &partitionsS, int countS, std::vector<JoinTask> &tasks) {
+        std::vector<double> costs(partitionsR.size());
+        double totalCost = 0;
+        #pragma omp parallel for num_threads(std::max(1, g_config.getNumThreads())) schedule(dynamic, 256) reduction(+:totalCost)
+        for (size_t i=0; i<partitionsR.size(); i++) {
+            costs[i] = estimateJoinCost(partitionsR[i], &partitionsS[i * countS], countS);
+            totalCost += costs[i];
+        }
+        int numThreads = std::max(1, g_config.getNumThreads());
+        double targetCost = totalCost / (numThreads * SPLIT_TASKS_PER_THREAD);
+        size_t splitCount = 0;
+        tasks.clear();
+        tasks.reserve(partitionsR.size());
+        for (size_t i=0; i<partitionsR.size(); i++) {
+            Partition* partitionR = partitionsR[i];
+            int blockCount = 1;
+            if (numThreads > 1 && costs[i] > targetCost) {
+                // a block holds at least one object of the largest R class list
+                size_t maxSizeR = 0;
+                for (auto &contents : partitionR->classIndex) {
+                    maxSizeR = std::max(maxSizeR, contents.size());
+                }
+                blockCount = (int) std::min((double) maxSizeR, ceil(costs[i] / targetCost));
+                blockCount = std::max(blockCount, 1);
+            }
+            if (blockCount > 1) {
+                splitCount++;
+            }
+            for (int block=0; block<blockCount; block++) {
+                tasks.push_back({partitionR, &partitionsS[i * countS], countS, block, blockCount, costs[i] / blockCount});
+            }
+        }
+        std::stable_sort(tasks.begin(), tasks.end(), [](const JoinTask &a, const JoinTask &b) {
+            return a.cost > b.cost;
+        });
+        if (splitCount > 0) {
+            logger::log_success("Split", splitCount, "partitions into", tasks.size() - (partitionsR.size() - splitCount), "join tasks");
+        }
+    }
+
+    /**
+    @brief Self-joins relate each unordered pair of distinct objects once, as (r, s) with r->recID < s->recID,
+     * and generate the text of both objects from it. Returns true for the pairs to skip.
+     */
+    static inline bool skipSymmetricPair(Shape* r, Shape* s) {
+        return g_config.datasetMetadata.getSelfJoin() && r->recID >= s->recID;
+    }
+
+    /** @brief Logs the time each thread spent joining tasks, the number of tasks it joined and the resulting load imbalance. */
+    static void printThreadBusyTimes(std::vector<double> &busyTimes, std::vector<size_t> &taskCounts) {
+        double maxBusy = 0;
+        double totalBusy = 0;
+        for (size_t tid=0; tid<busyTimes.size(); tid++) {
+            logger::log_success("Thread", tid, "busy for", busyTimes[tid], "seconds joining", taskCounts[tid], "tasks");
+            maxBusy = std::max(maxBusy, busyTimes[tid]);
+            totalBusy += busyTimes[tid];
+        }
+        if (totalBusy > 0) {
+            logger::log_success("Load imbalance (max/avg busy time):", maxBusy / (totalBusy / busyTimes.size()));
+        }
+    }
+
     namespace sentences
     {
         static inline DB_STATUS relateMBRs(Shape* objR, Shape* objS, std::string &relationText) {
@@ -84,94 +420,107 @@ namespace uniform_grid
     
         static inline DB_STATUS relate(Shape* r, Shape* s, std::string &relationText) {
             DB_STATUS ret = DBERR_OK;
-            if ((r->mbr.pMin.x > s->mbr.pMax.x) || (r->mbr.pMax.x < s->mbr.pMin.x)) {
-                // disjoint, only compute cardinal direction
-                CardinalDirection direction = CD_NONE;
-                ret = refinement::computeCardinalDirectionBetweenShapes(r, s, direction);
-                if (ret != DBERR_OK) {
-                    logger::log_error(ret, "Error while computing the cardinal direction between objects with ids", r->recID, "and", s->recID);
-                    return ret;
-                }
-                if (direction != CD_NONE) {
-                    // append cardinal direction to the relation text
-                    relationText = r->name + " is " + mapping::cardinalDirectionIntToString(direction) + " of " + s->name + ". ";
-                }
-                // logger::log_success("Generated relation for ids", r->recID, s->recID, ":", relationText);
-            } else {
-                // intersecting MBRs, relate more specifically
-                ret = relateMBRs(r, s, relationText);
-                if (ret != DBERR_OK) {
-                    return ret;
-                }
+            // intersecting MBRs (the only pairs reported by the joins, see sweepJoin), relate more specifically
+            ret = relateMBRs(r, s, relationText);
+            if (ret != DBERR_OK) {
+                return ret;
             }
             return ret;
         }
         
-        static inline DB_STATUS joinObjects(int tid, int partitionID, std::vector<Shape*>* objectsR, std::vector<Shape*>* objectsS) {
-            DB_STATUS ret = DBERR_OK;
+        /** @brief Relates a pair of objects and stores the generated text. */
+        static DB_STATUS relatePair(int tid, Shape* r, Shape* s) {
+            if (skipSymmetricPair(r, s)) {
+                return DBERR_OK;
+            }
             std::string relationText = "";
-            if (objectsR == nullptr || objectsS == nullptr) {
+            DB_STATUS ret = relate(r, s, relationText);
+            if (ret != DBERR_OK) {
                 return ret;
             }
-            if (objectsR->size() == 0 || objectsS->size() == 0) {
-                return ret;
+            if (relationText != "") {
+                // save the generated relation text in a buffer
+                g_config.diskWriter.addString(relationText, tid);
             }
-            auto r = objectsR->begin();
-            auto lastR = objectsR->end();
-            while (r != lastR) {
-                auto s = objectsS->begin();
-                auto lastS = objectsS->end();
-                while (s != lastS) {
-                    // check if the objects' bottom left CMBR point is inside this partition
-                    // (reference point duplicate elimination)
-                    double cxmin = std::max((*r)->mbr.pMin.x, (*s)->mbr.pMin.x);
-                    double cymin = std::max((*r)->mbr.pMin.y, (*s)->mbr.pMin.y);
-                    int partitionX = (cxmin - g_config.datasetMetadata.dataspaceMetadata.xMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.xExtent / (double) g_config.indexConfig.partitionsPerDim);
-                    int partitionY = (cymin - g_config.datasetMetadata.dataspaceMetadata.yMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.yExtent / (double) g_config.indexConfig.partitionsPerDim);
-                    int cmbrPartitionID = getPartitionID(partitionX, partitionY, g_config.indexConfig.partitionsPerDim);
-                    if (cmbrPartitionID == partitionID) {
-                        // relate objects
-                        ret = relate(*r, *s, relationText);
-                        if (ret != DBERR_OK) {
-                            return ret;
-                        }
-                        // save the generated relation text in a buffer
-                        g_config.diskWriter.addString(relationText, tid);
+            return ret;
+        }
+
+        static inline DB_STATUS joinObjects(int tid, ClassContents* contentsR, ClassContents* contentsS, int block, int blockCount) {
+            if (contentsR == nullptr || contentsS == nullptr) {
+                return DBERR_OK;
+            }
+            size_t rBegin, rEnd;
+            getBlockRange(contentsR->size(), block, blockCount, rBegin, rEnd);
+            return sweepJoin(*contentsR, rBegin, rEnd, *contentsS, [tid](Shape* r, Shape* s) {
+                return relatePair(tid, r, s);
+            });
+        }
+
+        static inline DB_STATUS joinPartitions(int tid, JoinTask &task) {
+            DB_STATUS ret = DBERR_OK;
+            for (int i=0; i<task.countS; i++) {
+                if (task.partitionsS[i] == nullptr) {
+                    continue;
+                }
+                for (auto &classPair : CLASS_PAIRS) {
+                    ret = joinObjects(tid, task.partitionR->getContents(classPair.first), task.partitionsS[i]->getContents(classPair.second), task.block, task.blockCount);
+                    if (ret != DBERR_OK) {
+                        return ret;
                     }
-                    s++;
                 }
-                r++;
             }
             return ret;
         }
 
-        DB_STATUS evaluate(Dataset* R, Dataset* S) {
+        DB_STATUS evaluate(Dataset* R, std::vector<Dataset*> &datasetsS) {
             DB_STATUS ret = DBERR_OK;
             int tid = -1;
             // here the final results will be stored
             logger::log_task("Evaluating...");
-            #pragma omp parallel num_threads(g_config.getNumThreads()) private(tid)
-            {
-                tid = omp_get_thread_num();
-                DB_STATUS local_ret = DBERR_OK;
-                // loop common partitions (todo: optimize to start from the dataset that has the fewer ones)
-                #pragma omp for
-                for (int i=0; i<R->uniformGridIndex.partitions.size(); i++) {
-                    // get partition ID and S container
-                    int partitionID = R->uniformGridIndex.partitions[i].partitionID;
-                    Partition* tlContainerS = S->uniformGridIndex.getPartition(partitionID);
-                    // if relation S has any objects for this partition (non-empty container)
-                    if (tlContainerS != nullptr) {
-                        // common partition found
-                        Partition* tlContainerR = &R->uniformGridIndex.partitions[i];
-                        local_ret = joinObjects(tid, partitionID, tlContainerR->getContents(), tlContainerS->getContents());
+            if (g_config.indexConfig.indexType == IT_RTREE) {
+                for (Dataset* S : datasetsS) {
+                    ret = rtree::join(R, S, relatePair);
+                    if (ret != DBERR_OK) {
+                        logger::log_error(ret, "R-tree join failed.");
+                        return ret;
+                    }
+                }
+            } else {
+                // the partitions (cells) that are non-empty in R and (any) S, split into tasks, most expensive first
+                std::vector<Partition*> partitionsR;
+                std::vector<Partition*> partitionsS;
+                ret = getCommonPartitions(R, datasetsS, partitionsR, partitionsS);
+                if (ret != DBERR_OK) {
+                    logger::log_error(ret, "Failed to find the common partitions.");
+                    return ret;
+                }
+                std::vector<JoinTask> tasks;
+                createJoinTasks(partitionsR, partitionsS, datasetsS.size(), tasks);
+                std::vector<double> busyTimes(g_config.getNumThreads(), 0);
+                std::vector<size_t> taskCounts(g_config.getNumThreads(), 0);
+                #pragma omp parallel num_threads(g_config.getNumThreads()) private(tid)
+                {
+                    tid = omp_get_thread_num();
+                    DB_STATUS local_ret = DBERR_OK;
+                    // accumulated locally and stored once, the per-thread slots share cache lines
+                    double busyTime = 0;
+                    size_t taskCount = 0;
+                    #pragma omp for schedule(dynamic, 1)
+                    for (int i=0; i<tasks.size(); i++) {
+                        double startTime = omp_get_wtime();
+                        local_ret = joinPartitions(tid, tasks[i]);
+                        busyTime += omp_get_wtime() - startTime;
+                        taskCount++;
                         if (local_ret != DBERR_OK) {
                             #pragma omp cancel for
                             ret = local_ret;
-                            logger::log_error(ret, "Join failed for partition", partitionID);
+                            logger::log_error(ret, "Join failed for partition", tasks[i].partitionR->partitionID);
                         }
                     }
+                    busyTimes[tid] = busyTime;
+                    taskCounts[tid] = taskCount;
                 }
+                printThreadBusyTimes(busyTimes, taskCounts);
             }
             // write header and rules (dont use this in multi-dataset runs as it will be written multiple times)
             // ret = g_config.diskWriter.writeFixedRules();
@@ -193,7 +542,7 @@ namespace uniform_grid
 
     namespace paragraphs
     {
-        static inline DB_STATUS relateMBRs(Shape* objR, Shape* objS) {
+        static inline DB_STATUS relateMBRs(int tid, Shape* objR, Shape* objS) {
             DB_STATUS ret = DBERR_OK;
             // compute deltas
             double d_xmin = objR->mbr.pMin.x - objS->mbr.pMin.x;
@@ -207,7 +556,7 @@ namespace uniform_grid
                     if (abs(d_ymin) < EPS) {
                         if (abs(d_ymax) < EPS) {
                             // equal MBRs
-                            ret = refinement::paragraphs::computeRelations(objR, objS, MBR_EQUAL, g_config.diskWriter.getDocumentType());
+                            ret = refinement::paragraphs::computeRelations(tid, objR, objS, MBR_EQUAL, g_config.diskWriter.getDocumentType());
                             if (ret != DBERR_OK) {
                                 logger::log_error(ret, "Forward for equal MBRs stopped with error.");
                             }
@@ -222,7 +571,7 @@ namespace uniform_grid
                     if (d_ymin <= 0) {
                         if (d_ymax >= 0) {
                             // MBR(s) inside MBR(r)
-                            ret = refinement::paragraphs::computeRelations(objR, objS, MBR_S_IN_R, g_config.diskWriter.getDocumentType());
+                            ret = refinement::paragraphs::computeRelations(tid, objR, objS, MBR_S_IN_R, g_config.diskWriter.getDocumentType());
                             if (ret != DBERR_OK) {
                                 logger::log_error(ret, "Forward for MBR(s) inside MBR(r) stopped with error.");
                             }
@@ -231,7 +580,7 @@ namespace uniform_grid
                     } else {
                         if (d_ymax < 0 && d_xmax > 0 && d_xmin < 0 && d_ymin < 0) {
                             // MBRs cross each other
-                            ret = refinement::paragraphs::computeRelations(objR, objS, MBR_CROSS, g_config.diskWriter.getDocumentType());
+                            ret = refinement::paragraphs::computeRelations(tid, objR, objS, MBR_CROSS, g_config.diskWriter.getDocumentType());
                             if (ret != DBERR_OK) {
                                 logger::log_error(ret, "Forward for MBRs cross stopped with error.");
                             }
@@ -245,7 +594,7 @@ namespace uniform_grid
                     if (d_ymin >= 0) {
                         if (d_ymax <= 0) {
                             // MBR(r) inside MBR(s)
-                            ret = refinement::paragraphs::computeRelations(objR, objS, MBR_R_IN_S, g_config.diskWriter.getDocumentType());
+                            ret = refinement::paragraphs::computeRelations(tid, objR, objS, MBR_R_IN_S, g_config.diskWriter.getDocumentType());
                             if (ret != DBERR_OK) {
                                 logger::log_error(ret, "Forward for MBR(r) inside MBR(s) stopped with error.");
                             }
@@ -254,7 +603,7 @@ namespace uniform_grid
                     } else {
                         if (d_ymax > 0 && d_xmax < 0 && d_xmin > 0 && d_ymin > 0) {
                             // MBRs cross each other
-                            ret = refinement::paragraphs::computeRelations(objR, objS, MBR_CROSS, g_config.diskWriter.getDocumentType());
+                            ret = refinement::paragraphs::computeRelations(tid, objR, objS, MBR_CROSS, g_config.diskWriter.getDocumentType());
                             if (ret != DBERR_OK) {
                                 logger::log_error(ret, "Forward for MBRs cross stopped with error.");
                             }
@@ -264,101 +613,102 @@ namespace uniform_grid
                 }
             }
             // MBRs intersect generally
-            ret = refinement::paragraphs::computeRelations(objR, objS, MBR_INTERSECT, g_config.diskWriter.getDocumentType());
+            ret = refinement::paragraphs::computeRelations(tid, objR, objS, MBR_INTERSECT, g_config.diskWriter.getDocumentType());
             if (ret != DBERR_OK) {
                 logger::log_error(ret, "Forward for MBRs intersect stopped with error.");
             }
             return ret;
         }
     
-        static inline DB_STATUS relate(Shape* r, Shape* s) {
+        static inline DB_STATUS relate(int tid, Shape* r, Shape* s) {
             DB_STATUS ret = DBERR_OK;
-            if ((r->mbr.pMin.x > s->mbr.pMax.x) || (r->mbr.pMax.x < s->mbr.pMin.x)) {
-                // disjoint, only compute cardinal direction
-                CardinalDirection direction = CD_NONE;
-                ret = refinement::computeCardinalDirectionBetweenShapes(r, s, direction);
-                if (ret != DBERR_OK) {
-                    logger::log_error(ret, "Error while computing the cardinal direction between objects with ids", r->recID, "and", s->recID);
-                    return ret;
-                }
-                if (direction != CD_NONE) {
-                    // append cardinal direction for the entities
-                    g_config.diskWriter.appendTextForEntity(r->name, r->name + " is " + mapping::cardinalDirectionIntToString(direction) + " of " + s->name + ". ");
-                    g_config.diskWriter.appendTextForEntity(s->name, s->name + " is " + mapping::cardinalDirectionIntToString(getOppositeCardinalDirection(direction)) + " of " + r->name + ". ");
-                }
-                // logger::log_success("Generated relation for ids", r->recID, s->recID, ":", relationText);
-            } else {
-                // intersecting MBRs, relate more specifically
-                ret = relateMBRs(r, s);
-                if (ret != DBERR_OK) {
-                    return ret;
-                }
+            if (skipSymmetricPair(r, s)) {
+                return ret;
+            }
+            // intersecting MBRs (the only pairs reported by the joins, see sweepJoin), relate more specifically
+            ret = relateMBRs(tid, r, s);
+            if (ret != DBERR_OK) {
+                return ret;
             }
             return ret;
         }
         
-        static inline DB_STATUS joinObjects(int tid, int partitionID, std::vector<Shape*>* objectsR, std::vector<Shape*>* objectsS) {
-            DB_STATUS ret = DBERR_OK;
-            if (objectsR == nullptr || objectsS == nullptr) {
-                return ret;
-            }
-            if (objectsR->size() == 0 || objectsS->size() == 0) {
-                return ret;
+        static inline DB_STATUS joinObjects(int tid, ClassContents* contentsR, ClassContents* contentsS, int block, int blockCount) {
+            if (contentsR == nullptr || contentsS == nullptr) {
+                return DBERR_OK;
             }
-            auto r = objectsR->begin();
-            auto lastR = objectsR->end();
-            while (r != lastR) {
-                auto s = objectsS->begin();
-                auto lastS = objectsS->end();
-                while (s != lastS) {
-                    // check if the objects' bottom left CMBR point is inside this partition
-                    // (reference point duplicate elimination)
-                    double cxmin = std::max((*r)->mbr.pMin.x, (*s)->mbr.pMin.x);
-                    double cymin = std::max((*r)->mbr.pMin.y, (*s)->mbr.pMin.y);
-                    int partitionX = (cxmin - g_config.datasetMetadata.dataspaceMetadata.xMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.xExtent / (double) g_config.indexConfig.partitionsPerDim);
-                    int partitionY = (cymin - g_config.datasetMetadata.dataspaceMetadata.yMinGlobal) / (g_config.datasetMetadata.dataspaceMetadata.yExtent / (double) g_config.indexConfig.partitionsPerDim);
-                    int cmbrPartitionID = getPartitionID(partitionX, partitionY, g_config.indexConfig.partitionsPerDim);
-                    if (cmbrPartitionID == partitionID) {
-                        // relate objects
-                        ret = relate(*r, *s);
-                        if (ret != DBERR_OK) {
-                            return ret;
-                        }
+            size_t rBegin, rEnd;
+            getBlockRange(contentsR->size(), block, blockCount, rBegin, rEnd);
+            return sweepJoin(*contentsR, rBegin, rEnd, *contentsS, [tid](Shape* r, Shape* s) {
+                return relate(tid, r, s);
+            });
+        }
+
+        static inline DB_STATUS joinPartitions(int tid, JoinTask &task) {
+            DB_STATUS ret = DBERR_OK;
+            for (int i=0; i<task.countS; i++) {
+                if (task.partitionsS[i] == nullptr) {
+                    continue;
+                }
+                for (auto &classPair : CLASS_PAIRS) {
+                    ret = joinObjects(tid, task.partitionR->getContents(classPair.first), task.partitionsS[i]->getContents(classPair.second), task.block, task.blockCount);
+                    if (ret != DBERR_OK) {
+                        return ret;
                     }
-                    s++;
                 }
-                r++;
             }
             return ret;
         }
 
-        DB_STATUS evaluate(Dataset* R, Dataset* S) {
+        DB_STATUS evaluate(Dataset* R, std::vector<Dataset*> &datasetsS) {
             DB_STATUS ret = DBERR_OK;
             int tid = -1;
             // here the final results will be stored
             logger::log_task("Evaluating...");
-            #pragma omp parallel num_threads(g_config.getNumThreads()) private(tid)
-            {
-                tid = omp_get_thread_num();
-                DB_STATUS local_ret = DBERR_OK;
-                // loop common partitions (todo: optimize to start from the dataset that has the fewer ones)
-                #pragma omp for
-                for (int i=0; i<R->uniformGridIndex.partitions.size(); i++) {
-                    // get partition ID and S container
-                    int partitionID = R->uniformGridIndex.partitions[i].partitionID;
-                    Partition* tlContainerS = S->uniformGridIndex.getPartition(partitionID);
-                    // if relation S has any objects for this partition (non-empty container)
-                    if (tlContainerS != nullptr) {
-                        // common partition found
-                        Partition* tlContainerR = &R->uniformGridIndex.partitions[i];
-                        local_ret = joinObjects(tid, partitionID, tlContainerR->getContents(), tlContainerS->getContents());
+            if (g_config.indexConfig.indexType == IT_RTREE) {
+                for (Dataset* S : datasetsS) {
+                    ret = rtree::join(R, S, relate);
+                    if (ret != DBERR_OK) {
+                        logger::log_error(ret, "R-tree join failed.");
+                        return ret;
+                    }
+                }
+            } else {
+                // the partitions (cells) that are non-empty in R and (any) S, split into tasks, most expensive first
+                std::vector<Partition*> partitionsR;
+                std::vector<Partition*> partitionsS;
+                ret = getCommonPartitions(R, datasetsS, partitionsR, partitionsS);
+                if (ret != DBERR_OK) {
+                    logger::log_error(ret, "Failed to find the common partitions.");
+                    return ret;
+                }
+                std::vector<JoinTask> tasks;
+                createJoinTasks(partitionsR, partitionsS, datasetsS.size(), tasks);
+                std::vector<double> busyTimes(g_config.getNumThreads(), 0);
+                std::vector<size_t> taskCounts(g_config.getNumThreads(), 0);
+                #pragma omp parallel num_threads(g_config.getNumThreads()) private(tid)
+                {
+                    tid = omp_get_thread_num();
+                    DB_STATUS local_ret = DBERR_OK;
+                    // accumulated locally and stored once, the per-thread slots share cache lines
+                    double busyTime = 0;
+                    size_t taskCount = 0;
+                    #pragma omp for schedule(dynamic, 1)
+                    for (int i=0; i<tasks.size(); i++) {
+                        double startTime = omp_get_wtime();
+                        local_ret = joinPartitions(tid, tasks[i]);
+                        busyTime += omp_get_wtime() - startTime;
+                        taskCount++;
                         if (local_ret != DBERR_OK) {
                             #pragma omp cancel for
                             ret = local_ret;
-                            logger::log_error(ret, "Join failed for partition", partitionID);
+                            logger::log_error(ret, "Join failed for partition", tasks[i].partitionR->partitionID);
                         }
                     }
+                    busyTimes[tid] = busyTime;
+                    taskCounts[tid] = taskCount;
                 }
+                printThreadBusyTimes(busyTimes, taskCounts);
             }
             // write header and rules (dont use this in multi-dataset runs as it will be written multiple times)
             // ret = g_config.diskWriter.writeFixedRules();
@@ -377,6 +727,32 @@ namespace uniform_grid
             return ret;
         }
     }
-    
-}
 
+    DB_STATUS evaluate(Dataset* R, Dataset* S) {
+        std::vector<Dataset*> datasetsS = {S};
+        return evaluate(R, datasetsS);
+    }
+
+    DB_STATUS evaluate(Dataset* R, std::vector<Dataset*> &datasetsS) {
+        DB_STATUS ret = DBERR_OK;
+        refinement::resetStatistics();
+        switch (g_config.diskWriter.getDocumentType()) {
+            case DOC_SENTENCES:
+                ret = sentences::evaluate(R, datasetsS);
+                break;
+            case DOC_PARAGRAPHS:
+            case DOC_PARAGRAPHS_COMPRESSED:
+                ret = paragraphs::evaluate(R, datasetsS);
+                break;
+            default:
+                logger::log_error(DBERR_INVALID_DOC_TYPE, "Invalid output document type, code:", g_config.diskWriter.getDocumentType());
+                return DBERR_INVALID_DOC_TYPE;
+        }
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Evaluation failed.");
+            return ret;
+        }
+        refinement::printStatistics();
+        return ret;
+    }
+}
@@ -0,0 +1,184 @@
+#include "index/quadtree.h"
+
+namespace quadtree
+{
+    /** @brief The number of cells per dimension of the finest grid, that all node boundaries are aligned to. */
+    static const int GRID_SIDE = 1 << MAX_DEPTH;
+
+    /** @brief A tree node. Leaves have no children, internal nodes have four consecutive ones (SW, SE, NW, NE). */
+    struct Node {
+        int32_t firstChild = -1;
+    };
+
+    /** @brief A rectangle of cells of the finest grid (inclusive). */
+    struct CellRange {
+        int xMin, yMin, xMax, yMax;
+    };
+
+    // the tree of the current run (root at position 0)
+    static std::vector<Node> nodes;
+    // the deepest leaf level
+    static int depth = 0;
+    // the most objects in a leaf, and the leaves over the capacity (inseparable objects or MAX_DEPTH reached)
+    static size_t maxLeafSize = 0;
+    static size_t oversizedLeaves = 0;
+
+    static inline int getCell(double value, double min, double extent) {
+        int cell = (value - min) / (extent / (double) GRID_SIDE);
+        return std::min(std::max(cell, 0), GRID_SIDE - 1);
+    }
+
+    static inline CellRange getCellRange(MBR &mbr) {
+        DataspaceMetadata &dataspace = g_config.datasetMetadata.dataspaceMetadata;
+        CellRange range;
+        range.xMin = getCell(mbr.pMin.x, dataspace.xMinGlobal, dataspace.xExtent);
+        range.yMin = getCell(mbr.pMin.y, dataspace.yMinGlobal, dataspace.yExtent);
+        range.xMax = getCell(mbr.pMax.x, dataspace.xMinGlobal, dataspace.xExtent);
+        range.yMax = getCell(mbr.pMax.y, dataspace.yMinGlobal, dataspace.yExtent);
+        return range;
+    }
+
+    /** @brief True if the range intersects the square of 'side' cells with bottom-left cell (x,y). */
+    static inline bool intersects(const CellRange &range, int x, int y, int side) {
+        return range.xMin < x + side && range.xMax >= x && range.yMin < y + side && range.yMax >= y;
+    }
+
+    /** @brief Returns the partition ID of the leaf with bottom-left cell (x,y) of the finest grid. */
+    static inline int getLeafID(int x, int y) {
+        int shift = MAX_DEPTH - depth;
+        return (x >> shift) + (y >> shift) * (1 << depth);
+    }
+
+    /** @brief True if all ranges share at least one cell of the finest grid. */
+    static bool shareCell(const std::vector<int> &items, const std::vector<CellRange> &ranges) {
+        CellRange common = ranges[items[0]];
+        for (auto &it : items) {
+            common.xMin = std::max(common.xMin, ranges[it].xMin);
+            common.yMin = std::max(common.yMin, ranges[it].yMin);
+            common.xMax = std::min(common.xMax, ranges[it].xMax);
+            common.yMax = std::min(common.yMax, ranges[it].yMax);
+            if (common.xMin > common.xMax || common.yMin > common.yMax) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @brief Marks the node as a leaf of the given level. */
+    static void makeLeaf(int level, size_t size) {
+        depth = std::max(depth, level);
+        if (size > g_config.indexConfig.leafCapacity) {
+            oversizedLeaves++;
+        }
+        maxLeafSize = std::max(maxLeafSize, size);
+    }
+
+    /**
+    @brief Splits the node while more than leafCapacity objects intersect it.
+     * Splitting continues even if all objects fall into a single quadrant (a dense cluster), since the empty 
+     * siblings cost nothing and MAX_DEPTH bounds the depth. A node stays a leaf if its objects all share 
+     * a cell of the finest grid, or if splitting would only copy them into the children without reducing the 
+     * work: the largest child still holds all of them, or the children together hold at least as many 
+     * candidate pairs as the node (e.g. heavily overlapping objects, where each split copies most of them).
+     * @param items The objects (positions in ranges) that intersect the node. Emptied in the process.
+     */
+    static void split(int32_t nodeIndex, int level, int x, int y, std::vector<int> &items, std::vector<CellRange> &ranges) {
+        if (items.size() <= g_config.indexConfig.leafCapacity || level == MAX_DEPTH || shareCell(items, ranges)) {
+            makeLeaf(level, items.size());
+            return;
+        }
+        int half = 1 << (MAX_DEPTH - level - 1);
+        std::vector<int> childItems[4];
+        size_t copies = 0;
+        size_t maxChildSize = 0;
+        double childPairs = 0;
+        for (int q=0; q<4; q++) {
+            int childX = x + (q & 1) * half;
+            int childY = y + (q >> 1) * half;
+            for (auto &it : items) {
+                if (intersects(ranges[it], childX, childY, half)) {
+                    childItems[q].emplace_back(it);
+                }
+            }
+            copies += childItems[q].size();
+            maxChildSize = std::max(maxChildSize, childItems[q].size());
+            childPairs += (double) childItems[q].size() * childItems[q].size();
+        }
+        // a split without copies (e.g. a cluster inside one quadrant) is always kept
+        if (copies > items.size()) {
+            if (maxChildSize == items.size() || childPairs >= (double) items.size() * items.size()) {
+                makeLeaf(level, items.size());
+                return;
+            }
+        }
+        std::vector<int>().swap(items);
+        int32_t firstChild = nodes.size();
+        nodes[nodeIndex].firstChild = firstChild;
+        nodes.resize(nodes.size() + 4);
+        for (int q=0; q<4; q++) {
+            split(firstChild + q, level + 1, x + (q & 1) * half, y + (q >> 1) * half, childItems[q], ranges);
+        }
+    }
+
+    static void collectLeaves(int32_t nodeIndex, int level, int x, int y, const CellRange &range, std::vector<int> &partitionIDs) {
+        if (nodes[nodeIndex].firstChild < 0) {
+            partitionIDs.emplace_back(getLeafID(x, y));
+            return;
+        }
+        int half = 1 << (MAX_DEPTH - level - 1);
+        for (int q=0; q<4; q++) {
+            int childX = x + (q & 1) * half;
+            int childY = y + (q >> 1) * half;
+            if (intersects(range, childX, childY, half)) {
+                collectLeaves(nodes[nodeIndex].firstChild + q, level + 1, childX, childY, range, partitionIDs);
+            }
+        }
+    }
+
+    DB_STATUS build(std::vector<MBR*> &mbrs) {
+        nodes.clear();
+        nodes.emplace_back();
+        depth = 0;
+        maxLeafSize = 0;
+        oversizedLeaves = 0;
+        std::vector<CellRange> ranges(mbrs.size());
+        std::vector<int> items(mbrs.size());
+        #pragma omp parallel for num_threads(std::max(1, g_config.getNumThreads()))
+        for (size_t i=0; i<mbrs.size(); i++) {
+            ranges[i] = getCellRange(*mbrs[i]);
+            items[i] = i;
+        }
+        split(0, 0, 0, 0, items, ranges);
+        g_config.indexConfig.partitionsPerDim = 1 << depth;
+        logger::log_success("Quadtree built with", (nodes.size() / 4) * 3 + 1, "leaves and depth", depth, "(largest leaf:", maxLeafSize, "objects)");
+        if (oversizedLeaves > 0) {
+            logger::log_warning(oversizedLeaves, "quadtree leaves hold more than", g_config.indexConfig.leafCapacity, "objects that can not be separated (common cell or maximum depth", MAX_DEPTH, "reached).");
+        }
+        return DBERR_OK;
+    }
+
+    void getCellRange(MBR &mbr, int &minCellX, int &minCellY, int &maxCellX, int &maxCellY) {
+        CellRange range = getCellRange(mbr);
+        int shift = MAX_DEPTH - depth;
+        minCellX = range.xMin >> shift;
+        minCellY = range.yMin >> shift;
+        maxCellX = range.xMax >> shift;
+        maxCellY = range.yMax >> shift;
+    }
+
+    DB_STATUS getPartitionsForCellRange(int minCellX, int minCellY, int maxCellX, int maxCellY, std::vector<int> &partitionIDs) {
+        if (nodes.empty()) {
+            logger::log_error(DBERR_INVALID_OPERATION, "The quadtree has not been built.");
+            return DBERR_INVALID_OPERATION;
+        }
+        // the leaves are aligned to the 2^depth grid, so the range is expanded to whole cells of the finest grid
+        int shift = MAX_DEPTH - depth;
+        CellRange range;
+        range.xMin = minCellX << shift;
+        range.yMin = minCellY << shift;
+        range.xMax = ((maxCellX + 1) << shift) - 1;
+        range.yMax = ((maxCellY + 1) << shift) - 1;
+        collectLeaves(0, 0, 0, 0, range, partitionIDs);
+        return DBERR_OK;
+    }
+}
@@ -3,97 +3,66 @@
 namespace refinement
 {
     /**
-     * Boost geometry refinement for find relation
+     * Boost geometry refinement for find relation.
+     * Each refinement case classifies the encoded DE-9IM matrix of the pair with the compiled masks. The 
+     * classification of all 512 possible codes is done at compile time into a decision table per case, 
+     * so refining a pair is one relate call and one table lookup.
      */
-    static inline bool compareDe9imChars(char character, char char_mask) {
-        if (character != 'F' && char_mask == 'T') {
-            // character is 0,1,2 and char_mask is T
-            return true;
-        } else if (character == 'F' && char_mask == 'F'){
-            // both are F
-            return true;
-        } else {
-            // no match
-            return false;
-        }
-    }
-
-    static inline bool compareMasks(std::string &de9imCode, char* maskCode) {
-        for(int i=0; i<9; i++) {
-            if (de9imCode[i] == '*' || maskCode[i] == '*' || compareDe9imChars(de9imCode[i], maskCode[i])){
-                continue;
-            } else {
-                return false;
-            }
-        }
-        return true;
-    }
-
-    static TopologyRelation refineDisjointInsideCoveredbyMeetIntersect(Shape* objR, Shape* objS) {
-        // get the mask code
-        std::string code = objR->createMaskCode(*objS);
+    static constexpr TopologyRelation classifyDisjointInsideCoveredbyMeetIntersect(De9imCode code) {
         // disjoint
-        if (compareMasks(code, disjointCode)) {
+        if (disjointMask.matches(code)) {
             return TR_DISJOINT;
         }
         // covered by
-        if (compareMasks(code, coveredbyCode1) || compareMasks(code, coveredbyCode2) || 
-            compareMasks(code, coveredbyCode3) || compareMasks(code, coveredbyCode4)) {
+        if (matchesAny(code, coveredByMaskList)) {
             // inside
-            if (compareMasks(code, insideCode)) {
+            if (insideMask.matches(code)) {
                 return TR_INSIDE;
             }
             return TR_COVERED_BY;
         }
         // meet
-        if (compareMasks(code, meetCode1) || compareMasks(code, meetCode2) || compareMasks(code, meetCode3)) {
+        if (matchesAny(code, meetMaskList)) {
             return TR_MEET;
         }
         // intersect
         return TR_INTERSECT;
     }
 
-    static TopologyRelation refineDisjointContainsCoversMeetIntersect(Shape* objR, Shape* objS) {
-        // get the mask code
-        std::string code = objR->createMaskCode(*objS);
+    static constexpr TopologyRelation classifyDisjointContainsCoversMeetIntersect(De9imCode code) {
         // disjoint
-        if (compareMasks(code, disjointCode)) {
+        if (disjointMask.matches(code)) {
             return TR_DISJOINT;
         }
         // covers
-        if (compareMasks(code, coversCode1) || compareMasks(code, coversCode2) || 
-            compareMasks(code, coversCode3) || compareMasks(code, coversCode4)) {
+        if (matchesAny(code, coversMaskList)) {
             // contains
-            if (compareMasks(code, containsCode)) {
+            if (containsMask.matches(code)) {
                 return TR_CONTAINS;
             }
             return TR_COVERS;
         }
         // meet
-        if (compareMasks(code, meetCode1) || compareMasks(code, meetCode2) || compareMasks(code, meetCode3)) {
+        if (matchesAny(code, meetMaskList)) {
             return TR_MEET;
         }
         // intersect
         return TR_INTERSECT;
     }
 
-    static TopologyRelation refineEqualCoversCoveredbyTrueHitIntersect(Shape* objR, Shape* objS) {
-        // get the mask code
-        std::string code = objR->createMaskCode(*objS);
+    static constexpr TopologyRelation classifyEqualCoversCoveredbyTrueHitIntersect(De9imCode code) {
         // check equality first because it is a subset of covers and covered by
-        if(compareMasks(code, equalCode)){
+        if (equalMask.matches(code)) {
             return TR_EQUAL;
         }
         // covers
-        if (compareMasks(code, coversCode1) || compareMasks(code, coversCode2) || 
-            compareMasks(code, coversCode3) || compareMasks(code, coversCode4)) {
+        if (matchesAny(code, coversMaskList)) {
             // return TR_COVERS;
             // instead of covers, classify as contains for consistency with the DE-9IM
             return TR_CONTAINS;
         }
         // covered by
-        if (compareMasks(code, coveredbyCode1) || compareMasks(code, coveredbyCode2) || 
-            compareMasks(code, coveredbyCode3) || compareMasks(code, coveredbyCode4)) {
+        if (matchesAny(code, coveredByMaskList)) {
             // return TR_COVERED_BY;
             // instead of covers, classify as contains for consistency with the DE-9IM
             return TR_INSIDE;
@@ -102,21 +71,366 @@ namespace refinement
         return TR_INTERSECT;
     }
 
-    static TopologyRelation refineDisjointMeetIntersect(Shape* objR, Shape* objS) {
-        // get the mask code
-        std::string code = objR->createMaskCode(*objS);   
+    static constexpr TopologyRelation classifyDisjointMeetIntersect(De9imCode code) {
         // disjoint
-        if (compareMasks(code, disjointCode)) {
+        if (disjointMask.matches(code)) {
             return TR_DISJOINT;
         }
         // meet
-        if (compareMasks(code, meetCode1) || compareMasks(code, meetCode2) || compareMasks(code, meetCode3)) {
+        if (matchesAny(code, meetMaskList)) {
             return TR_MEET;
         }
         // intersect
         return TR_INTERSECT;
     }
 
+    /** @brief The relation of every possible De9imCode, as classified by the given function. */
+    struct DecisionTable {
+        TopologyRelation relations[1 << 9];
+
+        constexpr DecisionTable(TopologyRelation (*classify)(De9imCode)) : relations() {
+            for (int code=0; code<(1 << 9); code++) {
+                relations[code] = classify(code);
+            }
+        }
+
+        /** @brief Returns the relation of the code (TR_INVALID for DE9IM_CODE_INVALID, i.e. unsupported geometry types). */
+        constexpr TopologyRelation lookup(De9imCode code) const {
+            return code < (1 << 9) ? relations[code] : TR_INVALID;
+        }
+    };
+
+    static constexpr DecisionTable disjointInsideCoveredbyMeetIntersectTable(classifyDisjointInsideCoveredbyMeetIntersect);
+    static constexpr DecisionTable disjointContainsCoversMeetIntersectTable(classifyDisjointContainsCoversMeetIntersect);
+    static constexpr DecisionTable equalCoversCoveredbyTrueHitIntersectTable(classifyEqualCoversCoveredbyTrueHitIntersect);
+    static constexpr DecisionTable disjointMeetIntersectTable(classifyDisjointMeetIntersect);
+
+    /** @brief Encodes a DE-9IM matrix given as a string (e.g. "FF2FF1212") like encodeDe9imMatrix. */
+    static constexpr De9imCode encodeDe9imString(const char* matrix) {
+        De9imCode code = 0;
+        for (int i=0; i<9; i++) {
+            if (matrix[i] != 'F') {
+                code |= 1 << i;
+            }
+        }
+        return code;
+    }
+
+    // the tables classify the matrices of representative polygon (and line) pairs as the mask codes do
+    static_assert(disjointInsideCoveredbyMeetIntersectTable.lookup(encodeDe9imString("FF2FF1212")) == TR_DISJOINT, "disjoint");
+    static_assert(disjointInsideCoveredbyMeetIntersectTable.lookup(encodeDe9imString("2FF1FF212")) == TR_INSIDE, "inside");
+    static_assert(disjointInsideCoveredbyMeetIntersectTable.lookup(encodeDe9imString("2FF11F212")) == TR_INSIDE, "inside, touching the boundary");
+    static_assert(disjointInsideCoveredbyMeetIntersectTable.lookup(encodeDe9imString("F1FFFF212")) == TR_COVERED_BY, "covered by (line on the boundary)");
+    static_assert(disjointInsideCoveredbyMeetIntersectTable.lookup(encodeDe9imString("FF2F11212")) == TR_MEET, "meet");
+    static_assert(disjointInsideCoveredbyMeetIntersectTable.lookup(encodeDe9imString("212101212")) == TR_INTERSECT, "intersect");
+    static_assert(disjointContainsCoversMeetIntersectTable.lookup(encodeDe9imString("FF2FF1212")) == TR_DISJOINT, "disjoint");
+    static_assert(disjointContainsCoversMeetIntersectTable.lookup(encodeDe9imString("212FF1FF2")) == TR_CONTAINS, "contains");
+    static_assert(disjointContainsCoversMeetIntersectTable.lookup(encodeDe9imString("FF21F1FF2")) == TR_COVERS, "covers (line on the boundary)");
+    static_assert(disjointContainsCoversMeetIntersectTable.lookup(encodeDe9imString("FF2F11212")) == TR_MEET, "meet");
+    static_assert(disjointContainsCoversMeetIntersectTable.lookup(encodeDe9imString("212101212")) == TR_INTERSECT, "intersect");
+    static_assert(equalCoversCoveredbyTrueHitIntersectTable.lookup(encodeDe9imString("2FFF1FFF2")) == TR_EQUAL, "equal");
+    static_assert(equalCoversCoveredbyTrueHitIntersectTable.lookup(encodeDe9imString("212F11FF2")) == TR_CONTAINS, "covers");
+    static_assert(equalCoversCoveredbyTrueHitIntersectTable.lookup(encodeDe9imString("2FF11F212")) == TR_INSIDE, "covered by");
+    static_assert(equalCoversCoveredbyTrueHitIntersectTable.lookup(encodeDe9imString("212101212")) == TR_INTERSECT, "intersect");
+    static_assert(disjointMeetIntersectTable.lookup(encodeDe9imString("FF2FF1212")) == TR_DISJOINT, "disjoint");
+    static_assert(disjointMeetIntersectTable.lookup(encodeDe9imString("FF2F11212")) == TR_MEET, "meet");
+    static_assert(disjointMeetIntersectTable.lookup(encodeDe9imString("212101212")) == TR_INTERSECT, "intersect");
+    static_assert(disjointMeetIntersectTable.lookup(DE9IM_CODE_INVALID) == TR_INVALID, "unsupported geometry types");
+
+    static inline TopologyRelation refineDisjointInsideCoveredbyMeetIntersect(Shape* objR, Shape* objS) {
+        return disjointInsideCoveredbyMeetIntersectTable.lookup(objR->createMaskCode(*objS));
+    }
+
+    static inline TopologyRelation refineDisjointContainsCoversMeetIntersect(Shape* objR, Shape* objS) {
+        return disjointContainsCoversMeetIntersectTable.lookup(objR->createMaskCode(*objS));
+    }
+
+    static inline TopologyRelation refineEqualCoversCoveredbyTrueHitIntersect(Shape* objR, Shape* objS) {
+        return equalCoversCoveredbyTrueHitIntersectTable.lookup(objR->createMaskCode(*objS));
+    }
+
+    static inline TopologyRelation refineDisjointMeetIntersect(Shape* objR, Shape* objS) {
+        return disjointMeetIntersectTable.lookup(objR->createMaskCode(*objS));
+    }
+
+    /**
+     * Targeted predicates (relate mode PREDICATES): only the masks that decide between the relations of each case are 
+     * tested, with boost's relate, which stops as soon as a mask is decided. First, a single point-in-polygon test of 
+     * one object's first vertex (a point of its boundary) in the other object narrows the candidate relations: 
+     * in the interior, the interiors intersect (not disjoint nor meet), in the exterior, the object is not covered by 
+     * the other. The classification is the same as the matrix one, for areal geometries.
+     */
+    namespace predicates
+    {
+        static const auto coveredByMasks = StaticMask<coveredbyCode1>() || StaticMask<coveredbyCode2>() || StaticMask<coveredbyCode3>() || StaticMask<coveredbyCode4>();
+        static const auto coversMasks = StaticMask<coversCode1>() || StaticMask<coversCode2>() || StaticMask<coversCode3>() || StaticMask<coversCode4>();
+        static const auto meetMasks = StaticMask<meetCode1>() || StaticMask<meetCode2>() || StaticMask<meetCode3>();
+
+        static TopologyRelation refineDisjointMeetIntersect(Shape* objR, Shape* objS) {
+            // disjoint
+            if (objR->relate(*objS, StaticMask<disjointCode>())) {
+                return TR_DISJOINT;
+            }
+            // meet
+            if (objR->relate(*objS, meetMasks)) {
+                return TR_MEET;
+            }
+            // intersect
+            return TR_INTERSECT;
+        }
+
+        static TopologyRelation refineDisjointInsideCoveredbyMeetIntersect(Shape* objR, Shape* objS) {
+            switch (objR->locateFirstVertex(*objS)) {
+                case PL_INTERIOR:
+                    // the interiors intersect, so covered by is inside
+                    return objR->relate(*objS, StaticMask<insideCode>()) ? TR_INSIDE : TR_INTERSECT;
+                case PL_EXTERIOR:
+                    // R is not covered by S
+                    return refineDisjointMeetIntersect(objR, objS);
+                default:
+                    break;
+            }
+            // disjoint
+            if (objR->relate(*objS, StaticMask<disjointCode>())) {
+                return TR_DISJOINT;
+            }
+            // covered by
+            if (objR->relate(*objS, coveredByMasks)) {
+                // inside
+                if (objR->relate(*objS, StaticMask<insideCode>())) {
+                    return TR_INSIDE;
+                }
+                return TR_COVERED_BY;
+            }
+            // meet
+            if (objR->relate(*objS, meetMasks)) {
+                return TR_MEET;
+            }
+            // intersect
+            return TR_INTERSECT;
+        }
+
+        static TopologyRelation refineDisjointContainsCoversMeetIntersect(Shape* objR, Shape* objS) {
+            switch (objS->locateFirstVertex(*objR)) {
+                case PL_INTERIOR:
+                    // the interiors intersect, so covers is contains
+                    return objR->relate(*objS, StaticMask<containsCode>()) ? TR_CONTAINS : TR_INTERSECT;
+                case PL_EXTERIOR:
+                    // R does not cover S
+                    return refineDisjointMeetIntersect(objR, objS);
+                default:
+                    break;
+            }
+            // disjoint
+            if (objR->relate(*objS, StaticMask<disjointCode>())) {
+                return TR_DISJOINT;
+            }
+            // covers
+            if (objR->relate(*objS, coversMasks)) {
+                // contains
+                if (objR->relate(*objS, StaticMask<containsCode>())) {
+                    return TR_CONTAINS;
+                }
+                return TR_COVERS;
+            }
+            // meet
+            if (objR->relate(*objS, meetMasks)) {
+                return TR_MEET;
+            }
+            // intersect
+            return TR_INTERSECT;
+        }
+
+        static TopologyRelation refineEqualCoversCoveredbyTrueHitIntersect(Shape* objR, Shape* objS) {
+            if (objR->locateFirstVertex(*objS) == PL_EXTERIOR) {
+                // R is neither equal to nor covered by S
+                return objR->relate(*objS, coversMasks) ? TR_CONTAINS : TR_INTERSECT;
+            }
+            if (objS->locateFirstVertex(*objR) == PL_EXTERIOR) {
+                // S is neither equal to nor covered by R
+                return objR->relate(*objS, coveredByMasks) ? TR_INSIDE : TR_INTERSECT;
+            }
+            // check equality first because it is a subset of covers and covered by
+            if (objR->relate(*objS, StaticMask<equalCode>())) {
+                return TR_EQUAL;
+            }
+            // covers (classified as contains, like the matrix refinement)
+            if (objR->relate(*objS, coversMasks)) {
+                return TR_CONTAINS;
+            }
+            // covered by (classified as inside, like the matrix refinement)
+            if (objR->relate(*objS, coveredByMasks)) {
+                return TR_INSIDE;
+            }
+            // intersect
+            return TR_INTERSECT;
+        }
+
+        static TopologyRelation refineIntersect(Shape* objR, Shape* objS) {
+            if (objR->locateFirstVertex(*objS) == PL_INTERIOR || objS->locateFirstVertex(*objR) == PL_INTERIOR) {
+                // the interiors intersect
+                return TR_INTERSECT;
+            }
+            return refineDisjointMeetIntersect(objR, objS);
+        }
+    }
+
+    /** @brief The refinement statistics of a thread (aligned, so that the threads do not share cache lines). */
+    struct alignas(64) RefinementStatistics {
+        double matrixTime = 0;
+        double predicatesTime = 0;
+        /** @brief All candidate pairs of the MBR filter. */
+        size_t candidates = 0;
+        /** @brief Candidate pairs decided by the MBR filter (crossing MBRs). */
+        size_t mbrHits = 0;
+        /** @brief Candidate pairs decided by the APRIL intermediate filter. */
+        size_t aprilHits = 0;
+        /** @brief Candidate pairs refined with the relate mode. */
+        size_t pairs = 0;
+        size_t mismatches = 0;
+        size_t aprilMismatches = 0;
+    };
+
+    static std::vector<RefinementStatistics> statistics(1);
+
+    void resetStatistics() {
+        statistics.assign(std::max(1, g_config.getNumThreads()), RefinementStatistics());
+    }
+
+    void printStatistics() {
+        RefinementStatistics total;
+        for (auto &it : statistics) {
+            total.matrixTime += it.matrixTime;
+            total.predicatesTime += it.predicatesTime;
+            total.candidates += it.candidates;
+            total.mbrHits += it.mbrHits;
+            total.aprilHits += it.aprilHits;
+            total.pairs += it.pairs;
+            total.mismatches += it.mismatches;
+            total.aprilMismatches += it.aprilMismatches;
+        }
+        // the hit rate of each filter stage, over all candidate pairs
+        double candidates = std::max(total.candidates, (size_t) 1);
+        logger::log_success("Candidate pairs:", total.candidates);
+        logger::log_success("  decided by the MBR filter:", total.mbrHits, "(", 100.0 * total.mbrHits / candidates, "% )");
+        if (g_config.indexConfig.aprilOrder > 0) {
+            logger::log_success("  decided by the APRIL filter:", total.aprilHits, "(", 100.0 * total.aprilHits / candidates, "% )");
+        }
+        logger::log_success("  refined:", total.candidates - total.mbrHits - total.aprilHits, "(", 100.0 * (total.candidates - total.mbrHits - total.aprilHits) / candidates, "% )");
+        RelateMode relateMode = g_config.indexConfig.relateMode;
+        if (relateMode == RM_MATRIX || relateMode == RM_CHECK) {
+            logger::log_success("Refined", total.pairs, "pairs with the DE-9IM matrix in", total.matrixTime, "seconds (all threads)");
+        }
+        if (relateMode == RM_PREDICATES || relateMode == RM_CHECK) {
+            logger::log_success("Refined", total.pairs, "pairs with targeted predicates in", total.predicatesTime, "seconds (all threads)");
+        }
+        if (relateMode == RM_CHECK) {
+            if (total.mismatches > 0) {
+                logger::log_warning("The predicates disagreed with the DE-9IM matrix for", total.mismatches, "pairs");
+            } else {
+                logger::log_success("The predicates agreed with the DE-9IM matrix for all pairs");
+            }
+            if (g_config.indexConfig.aprilOrder > 0) {
+                if (total.aprilMismatches > 0) {
+                    logger::log_warning("The APRIL filter disagreed with the DE-9IM matrix for", total.aprilMismatches, "pairs");
+                } else {
+                    logger::log_success("The APRIL filter agreed with the DE-9IM matrix for all pairs it decided");
+                }
+            }
+        }
+    }
+
+    /** @brief Refines the relation of the pair with the full DE-9IM matrix. */
+    static TopologyRelation refineWithMatrix(Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase) {
+        switch(mbrRelationCase) {
+            case MBR_R_IN_S:
+                return refineDisjointInsideCoveredbyMeetIntersect(objR, objS);
+            case MBR_S_IN_R:
+                return refineDisjointContainsCoversMeetIntersect(objR, objS);
+            case MBR_EQUAL:
+                return refineEqualCoversCoveredbyTrueHitIntersect(objR, objS);
+            case MBR_INTERSECT:
+                return refineDisjointMeetIntersect(objR, objS);
+            default:
+                return TR_INVALID;
+        }
+    }
+
+    /** @brief Refines the relation of the pair with targeted predicates (areal geometries, the matrix otherwise). */
+    static TopologyRelation refineWithPredicates(Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase) {
+        if (!objR->isAreal() || !objS->isAreal()) {
+            return refineWithMatrix(objR, objS, mbrRelationCase);
+        }
+        switch(mbrRelationCase) {
+            case MBR_R_IN_S:
+                return predicates::refineDisjointInsideCoveredbyMeetIntersect(objR, objS);
+            case MBR_S_IN_R:
+                return predicates::refineDisjointContainsCoversMeetIntersect(objR, objS);
+            case MBR_EQUAL:
+                return predicates::refineEqualCoversCoveredbyTrueHitIntersect(objR, objS);
+            case MBR_INTERSECT:
+                return predicates::refineIntersect(objR, objS);
+            default:
+                return TR_INVALID;
+        }
+    }
+
+    /**
+    @brief Finds the topological relation of the pair for its MBR relation case: pairs that are not decided by the MBR case
+     * or the APRIL intermediate filter (if enabled) are refined with the configured relate mode.
+     * The APRIL approximations are passed separately, since they belong to the index-resident shapes and not to 
+     * their materialized copies.
+     */
+    static DB_STATUS refine(Shape* objR, Shape* objS, const AprilData* aprilR, const AprilData* aprilS, MBRRelationCase mbrRelationCase, TopologyRelation &relation) {
+        RefinementStatistics &threadStatistics = statistics[omp_get_thread_num() % statistics.size()];
+        threadStatistics.candidates++;
+        if (mbrRelationCase == MBR_CROSS) {
+            threadStatistics.mbrHits++;
+            relation = TR_INTERSECT;
+            return DBERR_OK;
+        }
+        RelateMode relateMode = g_config.indexConfig.relateMode;
+        TopologyRelation aprilRelation = TR_INVALID;
+        bool aprilDecided = g_config.indexConfig.aprilOrder > 0 && april::filter(aprilR, aprilS, mbrRelationCase, aprilRelation);
+        if (aprilDecided) {
+            threadStatistics.aprilHits++;
+            if (relateMode != RM_CHECK) {
+                relation = aprilRelation;
+                return DBERR_OK;
+            }
+        }
+        double startTime;
+        if (relateMode != RM_PREDICATES) {
+            startTime = omp_get_wtime();
+            relation = refineWithMatrix(objR, objS, mbrRelationCase);
+            threadStatistics.matrixTime += omp_get_wtime() - startTime;
+        }
+        if (relateMode != RM_MATRIX) {
+            startTime = omp_get_wtime();
+            TopologyRelation predicatesRelation = refineWithPredicates(objR, objS, mbrRelationCase);
+            threadStatistics.predicatesTime += omp_get_wtime() - startTime;
+            if (relateMode == RM_CHECK && predicatesRelation != relation) {
+                // keep the matrix relation
+                threadStatistics.mismatches++;
+                logger::log_warning("Predicates relation", predicatesRelation, "differs from the DE-9IM matrix relation", relation, "for objects with ids", objR->recID, "and", objS->recID);
+            } else {
+                relation = predicatesRelation;
+            }
+        }
+        if (aprilDecided && aprilRelation != relation) {
+            // check mode, keep the matrix relation
+            threadStatistics.aprilMismatches++;
+            logger::log_warning("APRIL relation", aprilRelation, "differs from the DE-9IM matrix relation", relation, "for objects with ids", objR->recID, "and", objS->recID);
+        }
+        threadStatistics.pairs++;
+        if (relation == TR_INVALID) {
+            // invalid MBR relation case or unsupported geometry types
+            logger::log_error(DBERR_INVALID_OPERATION, "Failed to refine objects with ids", objR->recID, "and", objS->recID, "for mbr relation case", mbrRelationCase);
+            return DBERR_INVALID_OPERATION;
+        }
+        return DBERR_OK;
+    }
+
     DB_STATUS computeCardinalDirectionBetweenShapes(Shape* objR, Shape* objS, CardinalDirection &direction) {
         DB_STATUS ret = DBERR_OK;
 
@@ -178,28 +492,29 @@ namespace refinement
         return ret;
     }
 
-    static DB_STATUS computeIntersection(Shape* objR, Shape* objS, TopologyRelation relation, std::string &intersectionText) {
+    /** @brief Computes the common area of the objects, given their topological relation. */
+    static DB_STATUS computeIntersectionArea(Shape* objR, Shape* objS, TopologyRelation relation, double &area) {
         DB_STATUS ret = DBERR_OK;
         switch (relation) {
             case TR_DISJOINT:
             case TR_MEET:
                 // disjoint or meet, no common area
-                intersectionText = text_generator::generateAreaInSqkm(objR->name, objS->name, 0);
+                area = 0;
                 break;
             case TR_CONTAINS:
             case TR_COVERS:
             case TR_EQUAL:
                 // common area is the area of objS, since its being covered by R or is equal to S
-                intersectionText = text_generator::generateAreaInSqkm(objR->name, objS->name, objS->getArea());
+                area = objS->getArea();
                 break;
             case TR_INSIDE:
             case TR_COVERED_BY:
                 // common area is the area of objR, since its being covered by S
-                intersectionText = text_generator::generateAreaInSqkm(objR->name, objS->name, objR->getArea());
+                area = objR->getArea();
                 break;
             case TR_INTERSECT:
                 // actually compute the intersection area
-                intersectionText = text_generator::generateAreaInSqkm(objR->name, objS->name, objR->getIntersectionArea(*objS));
+                area = objR->getIntersectionArea(*objS);
                 break;
             default:
                 logger::log_error(DBERR_INVALID_PARAMETER, "Invalid topological relation with code:", relation);
@@ -209,57 +524,74 @@ namespace refinement
         return ret;
     }
 
+    /**
+    @brief Replaces the objects with the shapes that hold their full geometries (see GeometryCache::getGeometry). 
+     * The holders keep materialized geometries alive while they are used.
+     */
+    static inline DB_STATUS getGeometries(Shape* &objR, Shape* &objS, std::shared_ptr<Shape> &holderR, std::shared_ptr<Shape> &holderS) {
+        Shape* geometryR = GeometryCache::getGeometry(objR, holderR);
+        Shape* geometryS = GeometryCache::getGeometry(objS, holderS);
+        if (geometryR == nullptr || geometryS == nullptr) {
+            logger::log_error(DBERR_INVALID_GEOMETRY, "Failed to materialize the geometries of objects with ids", objR->recID, "and", objS->recID);
+            return DBERR_INVALID_GEOMETRY;
+        }
+        objR = geometryR;
+        objS = geometryS;
+        return DBERR_OK;
+    }
+
     namespace sentences
     {
+        /** @brief Generates the topological relation, direction and common area sentences of objR to objS. */
+        static std::string generateRelationSentences(Shape* objR, Shape* objS, TopologyRelation relation, CardinalDirection direction, double area) {
+            std::string relationText = text_generator::generateTopologicalRelation(objR->getName(), objS->getName(), relation);
+            if (relationText != "" && direction != CD_NONE) {
+                // append cardinal direction to the relation text
+                relationText += text_generator::generateDirectionalRelation(objR->getName(), objS->getName(), direction) + ". ";
+            }
+            relationText += text_generator::generateAreaInSqkm(objR->getName(), objS->getName(), area);
+            return relationText;
+        }
+
         DB_STATUS computeRelations(Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase, std::string &relationText) {
             DB_STATUS ret = DBERR_OK;
             TopologyRelation relation = TR_INVALID;
-            // switch based on MBR intersection case
-            switch(mbrRelationCase) {
-                case MBR_R_IN_S:
-                    relation = refineDisjointInsideCoveredbyMeetIntersect(objR, objS);
-                    break;
-                case MBR_S_IN_R:
-                    relation = refineDisjointContainsCoversMeetIntersect(objR, objS);
-                    break;
-                case MBR_EQUAL:
-                    relation = refineEqualCoversCoveredbyTrueHitIntersect(objR, objS);
-                    break;
-                case MBR_INTERSECT:
-                    relation = refineDisjointMeetIntersect(objR, objS);
-                    break;
-                case MBR_CROSS:
-                    relation = TR_INTERSECT;
-                    break;
-                default:
-                    logger::log_error(DBERR_INVALID_PARAMETER, "Invalid mbr relation case:", mbrRelationCase);
-                    return DBERR_INVALID_PARAMETER;
+            // get the full geometries (materialized for lazy shapes)
+            // (the APRIL approximations are read from the index-resident shapes before that)
+            const AprilData* aprilR = objR->aprilData;
+            const AprilData* aprilS = objS->aprilData;
+            std::shared_ptr<Shape> holderR, holderS;
+            ret = getGeometries(objR, objS, holderR, holderS);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+            // refine based on MBR intersection case
+            ret = refine(objR, objS, aprilR, aprilS, mbrRelationCase, relation);
+            if (ret != DBERR_OK) {
+                return ret;
             }
 
-            // use refinement result to generate the topological relation
-            relationText = text_generator::generateTopologicalRelation(objR->name, objS->name, relation);
             // special case, in adjacency also compute the cardinal direction if possible
-            if (relationText != "" && (relation == TR_MEET || relation == TR_DISJOINT)) {
-                CardinalDirection direction = CD_NONE;
+            CardinalDirection direction = CD_NONE;
+            if (relation == TR_MEET || relation == TR_DISJOINT) {
                 ret = computeCardinalDirectionBetweenShapes(objR, objS, direction);
                 if (ret != DBERR_OK) {
                     logger::log_error(ret, "Error while computing the cardinal direction between objects with ids", objR->recID, "and", objS->recID);
                     return ret;
                 }
-                if (direction != CD_NONE) {
-                    // append cardinal direction to the relation text
-                    relationText += objR->name + " is " + mapping::cardinalDirectionIntToString(direction) + " of " + objS->name + ". ";
-                }
             }
             // compute intersection
-            std::string intersectionText = "";
-            ret = computeIntersection(objR, objS, relation, intersectionText);
+            double area = 0;
+            ret = computeIntersectionArea(objR, objS, relation, area);
             if (ret != DBERR_OK) {
                 logger::log_error(ret, "Error while computing the intersection area between objects with ids", objR->recID, "and", objS->recID);
                 return ret;
             }
-            // append intersection text
-            relationText += intersectionText;
+            relationText = generateRelationSentences(objR, objS, relation, direction, area);
+            if (g_config.datasetMetadata.getSelfJoin()) {
+                // symmetric self-join: each pair is refined once, so generate the sentences of S too
+                relationText += generateRelationSentences(objS, objR, getSwappedTopologyRelation(relation), getOppositeCardinalDirection(direction), area);
+            }
 
             return ret;
         }
@@ -267,14 +599,12 @@ namespace refinement
 
     namespace paragraphs
     {
-        static DB_STATUS generateUncompressedRelationsText(Shape* objR, Shape* objS, TopologyRelation relation) {
+        static DB_STATUS generateUncompressedRelationsText(int tid, Shape* objR, Shape* objS, TopologyRelation relation) {
             DB_STATUS ret = DBERR_OK;
             // generate the topological relation
-            g_config.diskWriter.appendTextForEntity(objR->name, text_generator::generateTopologicalRelation(objR->name, objS->name, relation));
-            if (!g_config.datasetMetadata.getSelfJoin()) {
-                // if not a self join, get the reverse relation too
-                g_config.diskWriter.appendTextForEntity(objS->name, text_generator::generateTopologicalRelation(objS->name, objR->name, getSwappedTopologyRelation(relation)));
-            }
+            g_config.diskWriter.appendTextForEntity(tid, objR->nameID, text_generator::generateTopologicalRelation(objR->getName(), objS->getName(), relation));
+            // and the reverse relation (self-joins relate each pair once too)
+            g_config.diskWriter.appendTextForEntity(tid, objS->nameID, text_generator::generateTopologicalRelation(objS->getName(), objR->getName(), getSwappedTopologyRelation(relation)));
             // special case, in adjacency also compute the cardinal direction if possible
             if (relation == TR_MEET || relation == TR_DISJOINT) {
                 CardinalDirection direction = CD_NONE;
@@ -285,40 +615,29 @@ namespace refinement
                 }
                 if (direction != CD_NONE) {
                     // append cardinal direction for the entities
-                    g_config.diskWriter.appendTextForEntity(objR->name, objR->name + " is " + mapping::cardinalDirectionIntToString(direction) + " of " + objS->name + ". ");
-                    if (!g_config.datasetMetadata.getSelfJoin()) {
-                        // if not a self join, get the reverse relation too
-                        g_config.diskWriter.appendTextForEntity(objS->name, objS->name + " is " + mapping::cardinalDirectionIntToString(getOppositeCardinalDirection(direction)) + " of " + objR->name + ". ");
-                    }
+                    g_config.diskWriter.appendTextForEntity(tid, objR->nameID, text_generator::generateDirectionalRelation(objR->getName(), objS->getName(), direction) + ". ");
+                    g_config.diskWriter.appendTextForEntity(tid, objS->nameID, text_generator::generateDirectionalRelation(objS->getName(), objR->getName(), getOppositeCardinalDirection(direction)) + ". ");
                 }
             }
             // compute intersection
-            std::string intersectionText = "";
-            ret = computeIntersection(objR, objS, relation, intersectionText);
+            double area = 0;
+            ret = computeIntersectionArea(objR, objS, relation, area);
             if (ret != DBERR_OK) {
                 logger::log_error(ret, "Error while computing the intersection area between objects with ids", objR->recID, "and", objS->recID);
                 return ret;
             }
             // append intersection text
-            g_config.diskWriter.appendTextForEntity(objR->name, intersectionText);
-            if (!g_config.datasetMetadata.getSelfJoin()) {
-                // if not a self join, get the reverse relation too
-                g_config.diskWriter.appendTextForEntity(objS->name, intersectionText);
-            }
+            std::string intersectionText = text_generator::generateAreaInSqkm(objR->getName(), objS->getName(), area);
+            g_config.diskWriter.appendTextForEntity(tid, objR->nameID, intersectionText);
+            g_config.diskWriter.appendTextForEntity(tid, objS->nameID, intersectionText);
             return ret;
         }
 
-        static DB_STATUS generateCompressedRelationsText(Shape* objR, Shape* objS, TopologyRelation relation) {
+        static DB_STATUS generateCompressedRelationsText(int tid, Shape* objR, Shape* objS, TopologyRelation relation) {
             DB_STATUS ret = DBERR_OK;
             CardinalDirection direction = CD_NONE;
             std::string intersectionText = "";
 
-            // generate and append relations text for object R
-            if (g_config.datasetMetadata.getSelfJoin() && relation == TR_EQUAL) {
-                // ignore joining the same objects in self-joins
-                return DBERR_OK;
-            }
-
             // special case, in adjacency or disjointment also compute the cardinal direction if possible
             if (relation == TR_MEET || relation == TR_DISJOINT) {
                 ret = computeCardinalDirectionBetweenShapes(objR, objS, direction);
@@ -335,55 +654,46 @@ namespace refinement
                 }
             }
 
-            // get relations text
-            std::string relationsText = text_generator::generateCombinedTopologicalRelation(objR->name, objS->name, relation, direction, intersectionText);
-            g_config.diskWriter.appendTextForEntity(objR->name, relationsText);
+            // generate and append relations text for object R
+            std::string relationsText = text_generator::generateCombinedTopologicalRelation(objR->getName(), objS->getName(), relation, direction, intersectionText);
+            g_config.diskWriter.appendTextForEntity(tid, objR->nameID, relationsText);
 
-            // if not a self-join, compute the reverse relation text for object S 
-            if (!g_config.datasetMetadata.getSelfJoin()) {
-                TopologyRelation reverseRelation = getSwappedTopologyRelation(relation);
-                CardinalDirection reverseDirection = getOppositeCardinalDirection(direction);
-                std::string reverseRelationText = text_generator::generateCombinedTopologicalRelation(objS->name, objR->name, reverseRelation, reverseDirection, intersectionText);
-                g_config.diskWriter.appendTextForEntity(objS->name, reverseRelationText);
-            }
+            // the reverse relation text for object S (self-joins relate each pair once too)
+            TopologyRelation reverseRelation = getSwappedTopologyRelation(relation);
+            CardinalDirection reverseDirection = getOppositeCardinalDirection(direction);
+            std::string reverseRelationText = text_generator::generateCombinedTopologicalRelation(objS->getName(), objR->getName(), reverseRelation, reverseDirection, intersectionText);
+            g_config.diskWriter.appendTextForEntity(tid, objS->nameID, reverseRelationText);
 
             return ret;
         }
 
-        DB_STATUS computeRelations(Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase, DocumentType docType) {
+        DB_STATUS computeRelations(int tid, Shape* objR, Shape* objS, MBRRelationCase mbrRelationCase, DocumentType docType) {
             DB_STATUS ret = DBERR_OK;
             TopologyRelation relation = TR_INVALID;
-            // switch based on MBR intersection case
-            switch(mbrRelationCase) {
-                case MBR_R_IN_S:
-                    relation = refineDisjointInsideCoveredbyMeetIntersect(objR, objS);
-                    break;
-                case MBR_S_IN_R:
-                    relation = refineDisjointContainsCoversMeetIntersect(objR, objS);
-                    break;
-                case MBR_EQUAL:
-                    relation = refineEqualCoversCoveredbyTrueHitIntersect(objR, objS);
-                    break;
-                case MBR_INTERSECT:
-                    relation = refineDisjointMeetIntersect(objR, objS);
-                    break;
-                case MBR_CROSS:
-                    relation = TR_INTERSECT;
-                    break;
-                default:
-                    logger::log_error(DBERR_INVALID_PARAMETER, "Invalid mbr relation case:", mbrRelationCase);
-                    return DBERR_INVALID_PARAMETER;
+            // get the full geometries (materialized for lazy shapes)
+            // (the APRIL approximations are read from the index-resident shapes before that)
+            const AprilData* aprilR = objR->aprilData;
+            const AprilData* aprilS = objS->aprilData;
+            std::shared_ptr<Shape> holderR, holderS;
+            ret = getGeometries(objR, objS, holderR, holderS);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+            // refine based on MBR intersection case
+            ret = refine(objR, objS, aprilR, aprilS, mbrRelationCase, relation);
+            if (ret != DBERR_OK) {
+                return ret;
             }
 
             // generate the topological relation
             if (docType == DOC_PARAGRAPHS){
-                ret =  generateUncompressedRelationsText(objR, objS, relation);
+                ret =  generateUncompressedRelationsText(tid, objR, objS, relation);
                 if (ret != DBERR_OK) {
                     logger::log_error(ret, "Failed when generated the uncompressed relations text.");
                     return ret;
                 }    
             } else if (docType == DOC_PARAGRAPHS_COMPRESSED) {
-                ret =  generateCompressedRelationsText(objR, objS, relation);
+                ret =  generateCompressedRelationsText(tid, objR, objS, relation);
                 if (ret != DBERR_OK) {
                     logger::log_error(ret, "Failed when generated the uncompressed relations text.");
                     return ret;
@@ -0,0 +1,224 @@
+#include "index/rtree.h"
+
+namespace rtree
+{
+    /** @brief A pair of nodes (of R's and S's tree) whose MBRs intersect. */
+    struct NodePair {
+        int32_t nodeR;
+        int32_t nodeS;
+    };
+
+    static inline bool intersects(const MBR &a, const MBR &b) {
+        return a.pMin.x <= b.pMax.x && a.pMax.x >= b.pMin.x && a.pMin.y <= b.pMax.y && a.pMax.y >= b.pMin.y;
+    }
+
+    static inline void expandMBR(MBR &mbr, const MBR &other) {
+        mbr.pMin.x = std::min(mbr.pMin.x, other.pMin.x);
+        mbr.pMin.y = std::min(mbr.pMin.y, other.pMin.y);
+        mbr.pMax.x = std::max(mbr.pMax.x, other.pMax.x);
+        mbr.pMax.y = std::max(mbr.pMax.y, other.pMax.y);
+    }
+
+    /**
+    @brief Calculates the Sort-Tile-Recursive order of the MBRs: sorted by center x into sqrt(#nodes) vertical
+     * slices, each slice sorted by center y. Consecutive runs of 'capacity' MBRs in this order form the nodes.
+     */
+    static void getSTROrder(const std::vector<MBR> &mbrs, size_t capacity, std::vector<int32_t> &order) {
+        size_t count = mbrs.size();
+        order.resize(count);
+        for (size_t i=0; i<count; i++) {
+            order[i] = i;
+        }
+        size_t nodeCount = (count + capacity - 1) / capacity;
+        size_t sliceSize = (size_t) ceil(sqrt((double) nodeCount)) * capacity;
+        std::sort(order.begin(), order.end(), [&mbrs](int32_t a, int32_t b) {
+            return mbrs[a].pMin.x + mbrs[a].pMax.x < mbrs[b].pMin.x + mbrs[b].pMax.x;
+        });
+        for (size_t start=0; start<count; start+=sliceSize) {
+            std::sort(order.begin() + start, order.begin() + std::min(start + sliceSize, count), [&mbrs](int32_t a, int32_t b) {
+                return mbrs[a].pMin.y + mbrs[a].pMax.y < mbrs[b].pMin.y + mbrs[b].pMax.y;
+            });
+        }
+    }
+
+    /** @brief Groups consecutive runs of 'capacity' children (entries or nodes, starting at 'first') into parent nodes. */
+    static void packLevel(const std::vector<MBR> &mbrs, int32_t first, bool leaf, size_t capacity, std::vector<RTreeNode> &level) {
+        level.clear();
+        for (size_t start=0; start<mbrs.size(); start+=capacity) {
+            RTreeNode node;
+            node.first = first + start;
+            node.count = std::min(capacity, mbrs.size() - start);
+            node.leaf = leaf;
+            for (int32_t i=0; i<node.count; i++) {
+                expandMBR(node.mbr, mbrs[start + i]);
+            }
+            level.emplace_back(node);
+        }
+    }
+
+    DB_STATUS build(Dataset* dataset) {
+        RTreeIndex &tree = dataset->rtreeIndex;
+        size_t capacity = g_config.indexConfig.nodeCapacity;
+        tree.clear();
+        if (dataset->objectIDs.empty()) {
+            return DBERR_OK;
+        }
+        // leaves: the objects in STR order
+        std::vector<MBR> mbrs;
+        mbrs.reserve(dataset->objectIDs.size());
+        std::vector<Shape*> objects;
+        objects.reserve(dataset->objectIDs.size());
+        for (auto &recID : dataset->objectIDs) {
+            Shape* object = dataset->getObject(recID);
+            objects.emplace_back(object);
+            mbrs.emplace_back(object->mbr);
+        }
+        std::vector<int32_t> order;
+        getSTROrder(mbrs, capacity, order);
+        std::vector<MBR> sortedMBRs(mbrs.size());
+        tree.entries.resize(objects.size());
+        for (size_t i=0; i<order.size(); i++) {
+            tree.entries[i] = objects[order[i]];
+            sortedMBRs[i] = mbrs[order[i]];
+        }
+        std::vector<RTreeNode> level;
+        packLevel(sortedMBRs, 0, true, capacity, level);
+        tree.height = 1;
+        // upper levels: each level's nodes are STR ordered and stored, then packed into their parents
+        while (level.size() > 1) {
+            mbrs.resize(level.size());
+            for (size_t i=0; i<level.size(); i++) {
+                mbrs[i] = level[i].mbr;
+            }
+            getSTROrder(mbrs, capacity, order);
+            int32_t first = tree.nodes.size();
+            sortedMBRs.resize(level.size());
+            for (size_t i=0; i<order.size(); i++) {
+                tree.nodes.emplace_back(level[order[i]]);
+                sortedMBRs[i] = mbrs[order[i]];
+            }
+            packLevel(sortedMBRs, first, false, capacity, level);
+            tree.height++;
+        }
+        // the root
+        tree.nodes.emplace_back(level[0]);
+        return DBERR_OK;
+    }
+
+    /**
+    @brief Replaces the pair by the pairs of its intersecting children. Only the non-leaf side(s) are expanded.
+     */
+    static void expandPair(RTreeIndex &treeR, RTreeIndex &treeS, NodePair &pair, std::vector<NodePair> &childPairs) {
+        RTreeNode &nodeR = treeR.nodes[pair.nodeR];
+        RTreeNode &nodeS = treeS.nodes[pair.nodeS];
+        if (!nodeR.leaf && !nodeS.leaf) {
+            for (int32_t i=nodeR.first; i<nodeR.first + nodeR.count; i++) {
+                if (!intersects(treeR.nodes[i].mbr, nodeS.mbr)) {
+                    continue;
+                }
+                for (int32_t j=nodeS.first; j<nodeS.first + nodeS.count; j++) {
+                    if (intersects(treeR.nodes[i].mbr, treeS.nodes[j].mbr)) {
+                        childPairs.push_back({i, j});
+                    }
+                }
+            }
+        } else if (!nodeR.leaf) {
+            for (int32_t i=nodeR.first; i<nodeR.first + nodeR.count; i++) {
+                if (intersects(treeR.nodes[i].mbr, nodeS.mbr)) {
+                    childPairs.push_back({i, pair.nodeS});
+                }
+            }
+        } else {
+            for (int32_t j=nodeS.first; j<nodeS.first + nodeS.count; j++) {
+                if (intersects(nodeR.mbr, treeS.nodes[j].mbr)) {
+                    childPairs.push_back({pair.nodeR, j});
+                }
+            }
+        }
+    }
+
+    /** @brief Joins the entries of two intersecting leaves. */
+    static DB_STATUS joinLeaves(int tid, RTreeIndex &treeR, RTreeIndex &treeS, RTreeNode &leafR, RTreeNode &leafS, PairFunction pairFunction) {
+        DB_STATUS ret = DBERR_OK;
+        for (int32_t i=leafR.first; i<leafR.first + leafR.count; i++) {
+            Shape* objR = treeR.entries[i];
+            if (!intersects(objR->mbr, leafS.mbr)) {
+                continue;
+            }
+            for (int32_t j=leafS.first; j<leafS.first + leafS.count; j++) {
+                Shape* objS = treeS.entries[j];
+                if (intersects(objR->mbr, objS->mbr)) {
+                    ret = pairFunction(tid, objR, objS);
+                    if (ret != DBERR_OK) {
+                        return ret;
+                    }
+                }
+            }
+        }
+        return ret;
+    }
+
+    /** @brief Synchronized depth-first traversal of the subtrees of an intersecting pair of nodes. */
+    static DB_STATUS joinNodes(int tid, RTreeIndex &treeR, RTreeIndex &treeS, NodePair pair, PairFunction pairFunction) {
+        DB_STATUS ret = DBERR_OK;
+        RTreeNode &nodeR = treeR.nodes[pair.nodeR];
+        RTreeNode &nodeS = treeS.nodes[pair.nodeS];
+        if (nodeR.leaf && nodeS.leaf) {
+            return joinLeaves(tid, treeR, treeS, nodeR, nodeS, pairFunction);
+        }
+        std::vector<NodePair> childPairs;
+        expandPair(treeR, treeS, pair, childPairs);
+        for (auto &childPair : childPairs) {
+            ret = joinNodes(tid, treeR, treeS, childPair, pairFunction);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
+        return ret;
+    }
+
+    DB_STATUS join(Dataset* R, Dataset* S, PairFunction pairFunction) {
+        DB_STATUS ret = DBERR_OK;
+        RTreeIndex &treeR = R->rtreeIndex;
+        RTreeIndex &treeS = S->rtreeIndex;
+        if (!treeR.isBuilt() || !treeS.isBuilt()) {
+            return ret;
+        }
+        // expand the top levels breadth-first, until there are enough node pairs to balance across the threads
+        std::vector<NodePair> tasks;
+        if (intersects(treeR.getRoot()->mbr, treeS.getRoot()->mbr)) {
+            tasks.push_back({(int32_t) treeR.nodes.size() - 1, (int32_t) treeS.nodes.size() - 1});
+        }
+        size_t minTasks = 16 * (size_t) std::max(1, g_config.getNumThreads());
+        bool expanded = true;
+        while (tasks.size() < minTasks && expanded) {
+            expanded = false;
+            std::vector<NodePair> nextTasks;
+            for (auto &task : tasks) {
+                if (treeR.nodes[task.nodeR].leaf && treeS.nodes[task.nodeS].leaf) {
+                    nextTasks.emplace_back(task);
+                } else {
+                    expandPair(treeR, treeS, task, nextTasks);
+                    expanded = true;
+                }
+            }
+            tasks.swap(nextTasks);
+        }
+
+        #pragma omp parallel num_threads(g_config.getNumThreads())
+        {
+            int tid = omp_get_thread_num();
+            DB_STATUS local_ret = DBERR_OK;
+            #pragma omp for schedule(dynamic, 1)
+            for (int i=0; i<tasks.size(); i++) {
+                local_ret = joinNodes(tid, treeR, treeS, tasks[i], pairFunction);
+                if (local_ret != DBERR_OK) {
+                    #pragma omp cancel for
+                    ret = local_ret;
+                    logger::log_error(ret, "R-tree join failed for node pair", tasks[i].nodeR, tasks[i].nodeS);
+                }
+            }
+        }
+        return ret;
+    }
+}
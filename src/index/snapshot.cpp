@@ -0,0 +1,299 @@
+#include "index/snapshot.h"
+
+namespace uniform_grid
+{
+    namespace snapshot
+    {
+        /** @brief FNV-1a hash over 8-byte words (the tail bytes are hashed one by one). */
+        static uint64_t computeChecksum(const char* data, size_t size) {
+            const uint64_t prime = 1099511628211ULL;
+            uint64_t hash = 14695981039346656037ULL;
+            size_t words = size / sizeof(uint64_t);
+            for (size_t i=0; i<words; i++) {
+                uint64_t word;
+                memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+                hash = (hash ^ word) * prime;
+            }
+            for (size_t i=words * sizeof(uint64_t); i<size; i++) {
+                hash = (hash ^ (unsigned char) data[i]) * prime;
+            }
+            return hash;
+        }
+
+        std::string getDatasetKey(Dataset* dataset) {
+            struct stat st;
+            if (stat(dataset->path.c_str(), &st) != 0) {
+                return "";
+            }
+            return dataset->path + " " + std::to_string(st.st_size) + " " + std::to_string(st.st_mtime) + " "
+                + std::to_string(dataset->wktColIdx) + " " + std::to_string(dataset->nameColIdx) + " "
+                + std::to_string(dataset->otherColIdx) + " " + dataset->description;
+        }
+
+        static inline size_t alignedSize(size_t size) {
+            return (size + 7) & ~((size_t) 7);
+        }
+
+        static inline void writePadding(std::ofstream &fout) {
+            const char zeros[8] = {0};
+            size_t pos = fout.tellp();
+            fout.write(zeros, alignedSize(pos) - pos);
+        }
+
+        static DB_STATUS writeDataset(std::ofstream &fout, Dataset* dataset) {
+            DB_STATUS ret = DBERR_OK;
+            std::vector<Shape*> objects;
+            objects.reserve(dataset->objectIDs.size());
+            for (auto &recID : dataset->objectIDs) {
+                objects.emplace_back(dataset->getObject(recID));
+            }
+            std::string key = getDatasetKey(dataset);
+            if (key.empty()) {
+                logger::log_error(DBERR_FILE_OPEN, "Failed to stat dataset file:", dataset->path);
+                return DBERR_FILE_OPEN;
+            }
+            // the objects size is filled in after they are written
+            DatasetHeader datasetHeader;
+            datasetHeader.keyLength = key.length();
+            datasetHeader.objectsBytes = 0;
+            datasetHeader.objectCount = objects.size();
+            size_t datasetHeaderPos = fout.tellp();
+            fout.write(reinterpret_cast<const char*>(&datasetHeader), sizeof(DatasetHeader));
+            fout.write(key.data(), key.length());
+            writePadding(fout);
+            // objects
+            size_t objectsPos = fout.tellp();
+            ret = binary::writeObjects(fout, objects);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+            size_t objectsEndPos = fout.tellp();
+            datasetHeader.objectsBytes = objectsEndPos - objectsPos;
+            writePadding(fout);
+            // cell ranges
+            for (auto &object : objects) {
+                int32_t cellRange[4] = {object->minCellX, object->minCellY, object->maxCellX, object->maxCellY};
+                fout.write(reinterpret_cast<const char*>(cellRange), sizeof(cellRange));
+            }
+            writePadding(fout);
+            // fill in the objects size
+            size_t endPos = fout.tellp();
+            fout.seekp(datasetHeaderPos);
+            fout.write(reinterpret_cast<const char*>(&datasetHeader), sizeof(DatasetHeader));
+            fout.seekp(endPos);
+            if (!fout) {
+                logger::log_error(DBERR_FILE_WRITE, "Failed to write the snapshot of dataset", dataset->nickname);
+                return DBERR_FILE_WRITE;
+            }
+            return ret;
+        }
+
+        DB_STATUS save(std::string &path) {
+            DB_STATUS ret = DBERR_OK;
+            Dataset* R = g_config.datasetMetadata.getDatasetR();
+            Dataset* S = g_config.datasetMetadata.getDatasetS();
+            Header header;
+            memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+            header.version = SNAPSHOT_VERSION;
+            // in self-joins S aliases R, so only R's section is stored
+            header.datasetCount = (S == R) ? 1 : 2;
+            header.checksum = 0;
+            header.partitionsPerDim = g_config.indexConfig.partitionsPerDim;
+            header.xMinGlobal = g_config.datasetMetadata.dataspaceMetadata.xMinGlobal;
+            header.yMinGlobal = g_config.datasetMetadata.dataspaceMetadata.yMinGlobal;
+            header.xMaxGlobal = g_config.datasetMetadata.dataspaceMetadata.xMaxGlobal;
+            header.yMaxGlobal = g_config.datasetMetadata.dataspaceMetadata.yMaxGlobal;
+
+            std::ofstream fout(path, std::ios::out | std::ios::binary);
+            if (!fout.is_open()) {
+                logger::log_error(DBERR_FILE_OPEN, "Failed to open index snapshot file:", path);
+                return DBERR_FILE_OPEN;
+            }
+            fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            ret = writeDataset(fout, R);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+            if (S != R) {
+                ret = writeDataset(fout, S);
+                if (ret != DBERR_OK) {
+                    return ret;
+                }
+            }
+            fout.close();
+            if (fout.fail()) {
+                logger::log_error(DBERR_FILE_WRITE, "Failed to write index snapshot file:", path);
+                return DBERR_FILE_WRITE;
+            }
+
+            // checksum the payload and store it in the header
+            MappedFile file;
+            ret = file.map(path);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+            header.checksum = computeChecksum(file.data + sizeof(Header), file.size - sizeof(Header));
+            file.unmap();
+            std::fstream fheader(path, std::ios::in | std::ios::out | std::ios::binary);
+            fheader.seekp(0);
+            fheader.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            fheader.close();
+            if (fheader.fail()) {
+                logger::log_error(DBERR_FILE_WRITE, "Failed to write index snapshot header:", path);
+                return DBERR_FILE_WRITE;
+            }
+            logger::log_success("Saved index snapshot to", path);
+            return ret;
+        }
+
+        /** @brief A dataset's sections in the memory-mapped snapshot. */
+        struct DatasetSection {
+            const char* objects;
+            size_t objectsBytes;
+            size_t objectCount;
+            const int32_t* cellRanges;
+        };
+
+        /**
+        @brief Locates the sections of the dataset's snapshot at the given offset and verifies that they match the dataset.
+         * @param[in,out] offset Moved to the end of the dataset's snapshot.
+         * @return false if the snapshot does not match the dataset (or is truncated).
+         */
+        static bool readDatasetSection(MappedFile &file, size_t &offset, Dataset* dataset, DatasetSection &section) {
+            if (offset + sizeof(DatasetHeader) > file.size) {
+                return false;
+            }
+            const DatasetHeader* datasetHeader = reinterpret_cast<const DatasetHeader*>(file.data + offset);
+            offset += sizeof(DatasetHeader);
+            if (offset + datasetHeader->keyLength > file.size) {
+                return false;
+            }
+            std::string key(file.data + offset, datasetHeader->keyLength);
+            std::string currentKey = getDatasetKey(dataset);
+            if (currentKey.empty() || key != currentKey) {
+                logger::log_warning("Index snapshot is outdated for dataset", dataset->nickname);
+                return false;
+            }
+            offset += alignedSize(datasetHeader->keyLength);
+            section.objects = file.data + offset;
+            section.objectsBytes = datasetHeader->objectsBytes;
+            section.objectCount = datasetHeader->objectCount;
+            offset += alignedSize(datasetHeader->objectsBytes);
+            section.cellRanges = reinterpret_cast<const int32_t*>(file.data + offset);
+            offset += alignedSize(datasetHeader->objectCount * 4 * sizeof(int32_t));
+            return offset <= file.size;
+        }
+
+        /** @brief Builds the dataset's objects from its snapshot section and inserts them into its index. */
+        static DB_STATUS loadDataset(DatasetSection &section, Dataset* dataset) {
+            DB_STATUS ret = DBERR_OK;
+            std::vector<std::vector<Shape>> chunkObjects;
+            ret = binary::readObjects(section.objects, section.objectsBytes, chunkObjects);
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed to read the snapshot objects of dataset", dataset->nickname);
+                return ret;
+            }
+            size_t index = 0;
+            int partitionsPerDim = g_config.indexConfig.partitionsPerDim;
+            for (auto &chunk : chunkObjects) {
+                for (auto &object : chunk) {
+                    if (index >= section.objectCount) {
+                        logger::log_error(DBERR_INVALID_PARTITION, "Invalid partitions in the snapshot of dataset", dataset->nickname);
+                        return DBERR_INVALID_PARTITION;
+                    }
+                    const int32_t* cellRange = section.cellRanges + index * 4;
+                    if (cellRange[0] < 0 || cellRange[1] < 0 || cellRange[2] < cellRange[0] || cellRange[3] < cellRange[1] || cellRange[2] >= partitionsPerDim || cellRange[3] >= partitionsPerDim) {
+                        logger::log_error(DBERR_INVALID_PARTITION, "Invalid partitions in the snapshot of dataset", dataset->nickname);
+                        return DBERR_INVALID_PARTITION;
+                    }
+                    object.setCellRange(cellRange[0], cellRange[1], cellRange[2], cellRange[3]);
+                    ret = dataset->addObject(object);
+                    if (ret != DBERR_OK) {
+                        return ret;
+                    }
+                    index++;
+                }
+                // release the chunk's memory early
+                std::vector<Shape>().swap(chunk);
+            }
+            if (index != section.objectCount) {
+                logger::log_error(DBERR_INVALID_PARAMETER, "Object count mismatch in the snapshot of dataset", dataset->nickname);
+                return DBERR_INVALID_PARAMETER;
+            }
+            return ret;
+        }
+
+        /** @brief Sets the dataset's dataspace to the global bounds stored in the snapshot. */
+        static void setDataspace(Dataset* dataset, const Header* header) {
+            dataset->dataspaceMetadata.xMinGlobal = header->xMinGlobal;
+            dataset->dataspaceMetadata.yMinGlobal = header->yMinGlobal;
+            dataset->dataspaceMetadata.xMaxGlobal = header->xMaxGlobal;
+            dataset->dataspaceMetadata.yMaxGlobal = header->yMaxGlobal;
+        }
+
+        DB_STATUS load(std::string &path, bool &loaded) {
+            DB_STATUS ret = DBERR_OK;
+            Dataset* R = g_config.datasetMetadata.getDatasetR();
+            Dataset* S = g_config.datasetMetadata.getDatasetS();
+            loaded = false;
+            if (!verifyFilepath(path)) {
+                logger::log_warning("No index snapshot at", path);
+                return DBERR_OK;
+            }
+            MappedFile file;
+            ret = file.map(path);
+            if (ret != DBERR_OK) {
+                logger::log_warning("Failed to open index snapshot", path);
+                return DBERR_OK;
+            }
+            // verify header and checksum
+            const Header* header = reinterpret_cast<const Header*>(file.data);
+            if (file.size < sizeof(Header) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header->version != SNAPSHOT_VERSION) {
+                logger::log_warning("Ignoring invalid (or older version) index snapshot", path);
+                file.unmap();
+                return DBERR_OK;
+            }
+            uint32_t datasetCount = (S == R) ? 1 : 2;
+            if (header->datasetCount != datasetCount) {
+                logger::log_warning("Ignoring index snapshot", path, "with", header->datasetCount, "datasets, expected", datasetCount);
+                file.unmap();
+                return DBERR_OK;
+            }
+            if (header->partitionsPerDim != g_config.indexConfig.partitionsPerDim) {
+                logger::log_warning("Ignoring index snapshot built for", header->partitionsPerDim, "partitions per dimension:", path);
+                file.unmap();
+                return DBERR_OK;
+            }
+            if (computeChecksum(file.data + sizeof(Header), file.size - sizeof(Header)) != header->checksum) {
+                logger::log_warning("Ignoring corrupt index snapshot (checksum mismatch)", path);
+                file.unmap();
+                return DBERR_OK;
+            }
+            size_t offset = sizeof(Header);
+            DatasetSection sectionR, sectionS;
+            if (!readDatasetSection(file, offset, R, sectionR) || (S != R && !readDatasetSection(file, offset, S, sectionS)) || offset != file.size) {
+                logger::log_warning("Ignoring index snapshot that does not match the datasets:", path);
+                file.unmap();
+                return DBERR_OK;
+            }
+
+            // the snapshot is valid: set the dataspace and build the index
+            setDataspace(R, header);
+            setDataspace(S, header);
+            g_config.datasetMetadata.updateDataspace();
+            ret = loadDataset(sectionR, R);
+            if (ret == DBERR_OK && S != R) {
+                // in self-joins S aliases R and has no section
+                ret = loadDataset(sectionS, S);
+            }
+            file.unmap();
+            if (ret != DBERR_OK) {
+                logger::log_error(ret, "Failed while loading index snapshot", path);
+                return ret;
+            }
+            loaded = true;
+            logger::log_success("Loaded index snapshot from", path);
+            return ret;
+        }
+    }
+}
@@ -0,0 +1,256 @@
+#include "loader.h"
+
+namespace loader
+{
+    /** @brief Returns the number of tab-separated columns in the line (an empty last column does not count). */
+    static int countColumns(std::string_view line) {
+        if (line.empty()) {
+            return 0;
+        }
+        int count = std::count(line.begin(), line.end(), '\t') + 1;
+        if (line.back() == '\t') {
+            count--;
+        }
+        return count;
+    }
+
+    /**
+    @brief Single-pass tokenizer: finds the requested columns of a tab-separated line as views into it, 
+     * without copying. Scanning stops after the last requested column.
+     * @param[in] columnIdxs The requested column indexes (-1: not requested).
+     * @param[out] columns The view of each requested column.
+     * @param[out] found Whether each requested column exists in the line.
+     */
+    template<int N>
+    static inline void getColumns(std::string_view line, const int (&columnIdxs)[N], std::string_view (&columns)[N], bool (&found)[N]) {
+        int lastIdx = -1;
+        for (int k=0; k<N; k++) {
+            found[k] = false;
+            lastIdx = std::max(lastIdx, columnIdxs[k]);
+        }
+        size_t start = 0;
+        for (int col=0; col<=lastIdx; col++) {
+            size_t end = line.find('\t', start);
+            bool lastColumn = (end == std::string_view::npos);
+            if (lastColumn) {
+                if (start == line.size()) {
+                    // an empty last column does not count
+                    break;
+                }
+                end = line.size();
+            }
+            for (int k=0; k<N; k++) {
+                if (columnIdxs[k] == col) {
+                    columns[k] = line.substr(start, end - start);
+                    found[k] = true;
+                }
+            }
+            if (lastColumn) {
+                break;
+            }
+            start = end + 1;
+        }
+    }
+
+    DB_STATUS parseLine(Dataset* dataset, std::string_view line, size_t recID, Shape &object, LocalNamePool* names) {
+        DB_STATUS ret = DBERR_OK;
+        // get the wkt, name and other columns
+        const int columnIdxs[3] = {dataset->wktColIdx, dataset->nameColIdx, dataset->otherColIdx};
+        std::string_view columns[3];
+        bool found[3];
+        getColumns(line, columnIdxs, columns, found);
+        std::string_view wktData = columns[0];
+        std::string_view nameData = columns[1];
+        std::string_view otherData = columns[2];
+        if (!found[0]) {
+            logger::log_error(DBERR_INVALID_PARAMETER, "Invalid wkt column index for dataset. Value:", dataset->wktColIdx, "while the line has only", countColumns(line), "columns.");
+            return DBERR_INVALID_PARAMETER;
+        }
+        // get data type
+        DataType datatype = wkt::getDataType(wktData);
+        // create object
+        ret = shape_factory::createEmpty(datatype, object);
+        if (ret != DBERR_OK) {
+            // error creating shape
+            logger::log_error(ret, "Failed while creating empty shape of data type", mapping::dataTypeIntToStr(datatype));
+            return ret;
+        }
+        // get the name of the entity (not needed when re-parsing a lazy shape, which already has its name ID)
+        if (names != nullptr) {
+            if (!found[1]) {
+                logger::log_error(DBERR_INVALID_PARAMETER, "Invalid name column index for dataset. Value:", dataset->nameColIdx, "while the line has only", countColumns(line), "columns.");
+                return DBERR_INVALID_PARAMETER;
+            }
+            // add as object name the dataset type (if set) + object name
+            static thread_local std::string name;
+            if (dataset->description != "") {
+                name.reserve(dataset->description.length() + 1 + nameData.length());
+                name = dataset->description;
+                name += ' ';
+                name.append(nameData);
+            } else {
+                name.assign(nameData);
+            }
+            // get any other column to modify the name with
+            if (dataset->otherColIdx != -1){
+                if (!found[2]) {
+                    logger::log_error(DBERR_INVALID_PARAMETER, "Invalid other column index for dataset. Value:", dataset->otherColIdx, "while the line has only", countColumns(line), "columns.");
+                    return DBERR_INVALID_PARAMETER;
+                }
+                // state FP code (leading whitespace/sign allowed, like stoi)
+                const char* first = otherData.data();
+                const char* last = otherData.data() + otherData.size();
+                while (first < last && std::isspace((unsigned char) *first)) {
+                    first++;
+                }
+                if (first < last && *first == '+') {
+                    first++;
+                }
+                int stateFP;
+                if (std::from_chars(first, last, stateFP).ec != std::errc()) {
+                    logger::log_error(DBERR_INVALID_PARAMETER, "Invalid state FP value in other column:", std::string(otherData));
+                    return DBERR_INVALID_PARAMETER;
+                }
+                name += ", " + state::stateFpToStateName(stateFP);
+            }
+            object.nameID = names->intern(name);
+        }
+
+        // set rec ID
+        object.recID = recID;
+        // set object from the WKT
+        return object.setFromWKT(wktData);
+    }
+
+    /**
+    @brief Loads the objects of a TSV/WKT dataset in parallel. 
+     * The memory-mapped file is split into newline-aligned chunks, one per thread. Each thread parses its lines 
+     * into its own list (with MBRs set), using chunk-relative line numbers which are then offset by the line count 
+     * of all previous chunks. Thus record IDs remain the line numbers and the chunks are in file order.
+     * Names are interned into a pool per chunk, which are merged into the shared pool in chunk order.
+     * @param[out] chunkObjects The parsed objects, one list per chunk.
+     */
+    static DB_STATUS loadTSV(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
+        DB_STATUS ret = DBERR_OK;
+        MappedFile file;
+        ret = file.map(dataset->path);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed to open dataset path:", dataset->path);
+            return ret;
+        }
+        // split into newline-aligned chunks
+        int numChunks = std::max(1, g_config.getNumThreads());
+        std::vector<size_t> chunkStart(numChunks + 1, file.size);
+        chunkStart[0] = 0;
+        for (int c=1; c<numChunks; c++) {
+            size_t pos = std::max(chunkStart[c-1], (file.size / numChunks) * c);
+            if (pos > 0 && pos < file.size) {
+                // move to the start of the next line
+                const char* newline = (const char*) memchr(file.data + pos - 1, '\n', file.size - pos + 1);
+                pos = (newline == nullptr) ? file.size : (newline - file.data) + 1;
+            }
+            chunkStart[c] = pos;
+        }
+        // in lazy mode, geometries are parsed again on demand through the dataset's geometry cache
+        GeometryCache* cache = nullptr;
+        if (g_config.indexConfig.lazyGeometries) {
+            dataset->geometryCache = std::make_shared<GeometryCache>(dataset, g_config.indexConfig.geometryCacheBytes);
+            ret = dataset->geometryCache->open();
+            if (ret != DBERR_OK) {
+                file.unmap();
+                return ret;
+            }
+            cache = dataset->geometryCache.get();
+        }
+        chunkObjects.clear();
+        chunkObjects.resize(numChunks);
+        std::vector<size_t> chunkLineCount(numChunks, 0);
+        std::vector<DB_STATUS> chunkRet(numChunks, DBERR_OK);
+        std::vector<size_t> chunkErrorLine(numChunks, 0);
+        // names are interned per chunk without locking and merged into the shared pool afterwards
+        std::vector<LocalNamePool> chunkNames(numChunks);
+        
+        #pragma omp parallel for num_threads(numChunks) schedule(static, 1)
+        for (int c=0; c<numChunks; c++) {
+            const char* cursor = file.data + chunkStart[c];
+            const char* chunkEnd = file.data + chunkStart[c+1];
+            size_t lineCounter = 0;
+            while (cursor < chunkEnd) {
+                const char* newline = (const char*) memchr(cursor, '\n', chunkEnd - cursor);
+                if (newline == nullptr) {
+                    newline = chunkEnd;
+                }
+                std::string_view line(cursor, newline - cursor);
+                Shape object;
+                DB_STATUS local_ret = parseLine(dataset, line, lineCounter, object, &chunkNames[c]);
+                if (local_ret == DBERR_INVALID_GEOMETRY) {
+                    // this line is not the appropriate geometry type, so just ignore
+                } else if (local_ret != DBERR_OK) {
+                    // some other error occured (e.g. malformed WKT), interrupt this chunk
+                    chunkRet[c] = local_ret;
+                    chunkErrorLine[c] = lineCounter;
+                    break;
+                } else {
+                    // valid object, set the MBR
+                    object.setMBR();
+                    if (cache != nullptr) {
+                        object.makeLazy(cache, cursor - file.data, newline - cursor);
+                    }
+                    chunkObjects[c].emplace_back(std::move(object));
+                }
+                lineCounter += 1;
+                cursor = newline + 1;
+            }
+            chunkLineCount[c] = lineCounter;
+        }
+        file.unmap();
+        // the chunks before the first failed one were read fully, so its line number is known
+        size_t errorLineOffset = 0;
+        for (int c=0; c<numChunks; c++) {
+            if (chunkRet[c] != DBERR_OK) {
+                if (chunkRet[c] == DBERR_INVALID_WKT) {
+                    logger::log_error(chunkRet[c], "Malformed WKT at line", errorLineOffset + chunkErrorLine[c] + 1, "of", dataset->path);
+                }
+                return chunkRet[c];
+            }
+            errorLineOffset += chunkLineCount[c];
+        }
+        // intern the chunk names in file order (so name IDs do not depend on the thread count or timing)
+        std::vector<std::vector<uint32_t>> chunkPoolIDs(numChunks);
+        for (int c=0; c<numChunks; c++) {
+            chunkPoolIDs[c].resize(chunkNames[c].size());
+            for (uint32_t i=0; i<chunkNames[c].size(); i++) {
+                chunkPoolIDs[c][i] = g_config.datasetMetadata.namePool.intern(chunkNames[c].get(i));
+            }
+        }
+        // turn chunk-relative line numbers into file line numbers and chunk name IDs into pool name IDs
+        std::vector<size_t> lineOffset(numChunks, 0);
+        for (int c=1; c<numChunks; c++) {
+            lineOffset[c] = lineOffset[c-1] + chunkLineCount[c-1];
+        }
+        #pragma omp parallel for num_threads(numChunks) schedule(static, 1)
+        for (int c=0; c<numChunks; c++) {
+            for (auto &object : chunkObjects[c]) {
+                object.recID += lineOffset[c];
+                object.nameID = chunkPoolIDs[c][object.nameID];
+            }
+        }
+
+        return ret;
+    }
+
+    DB_STATUS loadDataset(Dataset* dataset, std::vector<std::vector<Shape>> &chunkObjects) {
+        switch (dataset->fileFormat) {
+            case FT_WKT:
+                return loadTSV(dataset, chunkObjects);
+            case FT_BINARY:
+                if (g_config.indexConfig.lazyGeometries) {
+                    logger::log_warning("Lazy geometries are only supported for TSV/WKT datasets, loading", dataset->nickname, "fully.");
+                }
+                return binary::loadDataset(dataset, chunkObjects);
+            default:
+                logger::log_error(DBERR_INVALID_PARAMETER, "Unsupported file format for dataset", dataset->nickname, "code:", dataset->fileFormat);
+                return DBERR_INVALID_PARAMETER;
+        }
+    }
+}
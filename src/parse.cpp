@@ -3,6 +3,30 @@
 // property tree var
 static boost::property_tree::ptree dataset_config_pt;
 
+/** @brief Codes for the long-only command line options. */
+enum LongOption {
+    OPT_SAVE_INDEX = 256,
+    OPT_LOAD_INDEX,
+    OPT_GEOMETRY_CACHE_MB,
+    OPT_LEAF_CAPACITY,
+    OPT_NODE_CAPACITY,
+    OPT_RELATE,
+    OPT_APRIL,
+    OPT_APRIL_DIR,
+};
+
+static struct option long_options[] = {
+    {"save-index", required_argument, 0, OPT_SAVE_INDEX},
+    {"load-index", required_argument, 0, OPT_LOAD_INDEX},
+    {"geometry-cache-mb", required_argument, 0, OPT_GEOMETRY_CACHE_MB},
+    {"leaf-capacity", required_argument, 0, OPT_LEAF_CAPACITY},
+    {"node-capacity", required_argument, 0, OPT_NODE_CAPACITY},
+    {"relate", required_argument, 0, OPT_RELATE},
+    {"april", required_argument, 0, OPT_APRIL},
+    {"april-dir", required_argument, 0, OPT_APRIL_DIR},
+    {0, 0, 0, 0}
+};
+
 static DB_STATUS verifyDatasetStatement(DatasetStatement &datasetStmt) {    
     // verify filepath
     if (!verifyFilepath(datasetStmt.path)) {
@@ -54,7 +78,7 @@ static DB_STATUS verifyDocumentTypeStatement(std::string &docTypeStr) {
 
 static DB_STATUS verifyArguments(ArgumentsStatement &argsStmt) {
     DB_STATUS ret = DBERR_OK;
-    if (!argsStmt.datasetR.set || !argsStmt.datasetS.set) {
+    if (!argsStmt.datasetR.set || argsStmt.datasetsS.empty()) {
         logger::log_error(DBERR_INVALID_ARGS, "Two datasets must be set. Use both -R and -S arguments.");
         return DBERR_INVALID_ARGS;
     }
@@ -65,10 +89,27 @@ static DB_STATUS verifyArguments(ArgumentsStatement &argsStmt) {
         return ret;
     }
     // S
-    ret = verifyDatasetStatement(argsStmt.datasetS);
-    if (ret != DBERR_OK) {
-        logger::log_error(ret, "Failed while verifying dataset S.");
-        return ret;
+    for (auto &datasetS : argsStmt.datasetsS) {
+        ret = verifyDatasetStatement(datasetS);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while verifying dataset S", datasetS.nickname);
+            return ret;
+        }
+    }
+    if (argsStmt.datasetsS.size() > 1) {
+        // multi-way join: each S dataset is joined once, self-joins are run on their own
+        for (size_t i=0; i<argsStmt.datasetsS.size(); i++) {
+            if (argsStmt.datasetsS[i].path.compare(argsStmt.datasetR.path) == 0) {
+                logger::log_error(DBERR_INVALID_ARGS, "Dataset R can not be one of several S datasets (run its self-join separately):", argsStmt.datasetsS[i].nickname);
+                return DBERR_INVALID_ARGS;
+            }
+            for (size_t j=0; j<i; j++) {
+                if (argsStmt.datasetsS[i].path.compare(argsStmt.datasetsS[j].path) == 0) {
+                    logger::log_error(DBERR_INVALID_ARGS, "Dataset S is given more than once:", argsStmt.datasetsS[i].nickname);
+                    return DBERR_INVALID_ARGS;
+                }
+            }
+        }
     }
     // output
     ret = verifyOutputSetupFilepath(argsStmt.outputStmt);
@@ -113,6 +154,11 @@ static DB_STATUS loadMetadata(DatasetStatement &stmt) {
         return DBERR_INI_ERROR;
     }
 
+    if (stmt.fileFormat == FT_BINARY) {
+        // binary datasets hold the geometries and names directly, no columns
+        return DBERR_OK;
+    }
+
     try {
         stmt.wktColIdx = dataset_config_pt.get<int>(stmt.nickname+".wktcolidx");
     }
@@ -142,18 +188,109 @@ static DB_STATUS loadMetadata(DatasetStatement &stmt) {
     return DBERR_OK;
 }
 
+/** @brief Returns the string without leading and trailing whitespace. */
+static std::string trimSpaces(const std::string &str) {
+    size_t first = str.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = str.find_last_not_of(" \t\r");
+    return str.substr(first, last - first + 1);
+}
+
+/** @brief Loads and verifies the dataset statement of a job (datasets are keyed by nickname in batch mode). */
+static DB_STATUS loadJobDataset(std::string nickname, DatasetStatement &datasetStmt) {
+    datasetStmt.set = true;
+    datasetStmt.nickname = nickname;
+    datasetStmt.key = nickname;
+    DB_STATUS ret = loadMetadata(datasetStmt);
+    if (ret != DBERR_OK) {
+        return ret;
+    }
+    return verifyDatasetStatement(datasetStmt);
+}
+
+/**
+@brief Loads the jobs of a job file into the configuration (batch mode). 
+ * Each non-empty line that does not start with '#' is a job: R, S, partitionsPerDim, documentType, outputPath [, append]
+ */
+static DB_STATUS loadJobFile(std::string &jobFilePath) {
+    DB_STATUS ret = DBERR_OK;
+    std::ifstream fin(jobFilePath);
+    if (!fin.is_open()) {
+        logger::log_error(DBERR_FILE_OPEN, "Failed to open job file:", jobFilePath);
+        return DBERR_FILE_OPEN;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(fin, line)) {
+        lineNumber++;
+        line = trimSpaces(line);
+        if (line == "" || line[0] == '#') {
+            continue;
+        }
+        // split the fields
+        std::vector<std::string> fields;
+        std::stringstream lineStream(line);
+        std::string field;
+        while (std::getline(lineStream, field, ',')) {
+            fields.emplace_back(trimSpaces(field));
+        }
+        if (fields.size() != 5 && !(fields.size() == 6 && fields[5] == "append")) {
+            logger::log_error(DBERR_INVALID_ARGS, "Invalid job at line", lineNumber, "of the job file. Expected: R, S, partitionsPerDim, documentType, outputPath [, append]");
+            return DBERR_INVALID_ARGS;
+        }
+        JobStatement job;
+        ret = loadJobDataset(fields[0], job.datasetR);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while verifying dataset R of the job at line", lineNumber);
+            return ret;
+        }
+        ret = loadJobDataset(fields[1], job.datasetS);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while verifying dataset S of the job at line", lineNumber);
+            return ret;
+        }
+        job.partitionsPerDim = atoi(fields[2].c_str());
+        if (job.partitionsPerDim <= 0) {
+            logger::log_error(DBERR_INVALID_ARGS, "Invalid partitions per dimension at line", lineNumber, "of the job file:", fields[2]);
+            return DBERR_INVALID_ARGS;
+        }
+        job.outputStmt.documentType = fields[3];
+        job.outputStmt.outputFilepath = fields[4];
+        job.outputStmt.append = fields.size() == 6;
+        ret = verifyDocumentTypeStatement(job.outputStmt.documentType);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while verifying the output document type of the job at line", lineNumber);
+            return ret;
+        }
+        ret = verifyOutputSetupFilepath(job.outputStmt);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while verifying the output filepath of the job at line", lineNumber);
+            return ret;
+        }
+        g_config.jobs.emplace_back(job);
+    }
+    if (g_config.jobs.empty()) {
+        logger::log_error(DBERR_INVALID_ARGS, "The job file has no jobs:", jobFilePath);
+        return DBERR_INVALID_ARGS;
+    }
+    return ret;
+}
+
 namespace parse
 {
     DB_STATUS parseArguments(int argc, char *argv[]) {
-        char c;
+        int c;
         DB_STATUS ret = DBERR_OK;
         ArgumentsStatement argsStmt;
+        std::string jobFilePath = "";
         
         // open the config file parser
         boost::property_tree::ini_parser::read_ini(g_config.dirPaths.datasetsConfigPath, dataset_config_pt);
 
         // after config file has been loaded, parse cmd arguments and overwrite any selected options
-        while ((c = getopt(argc, argv, "R:S:p:t:ao:d:?")) != -1)
+        while ((c = getopt_long(argc, argv, "R:S:p:t:ao:d:blj:i:?", long_options, NULL)) != -1)
         {
             switch (c)
             {
@@ -164,10 +301,14 @@ namespace parse
                     argsStmt.datasetR.key = std::string(optarg) + "_R";
                     break;
                 case 'S':
-                    // Dataset S path
-                    argsStmt.datasetS.set = true;
-                    argsStmt.datasetS.nickname = std::string(optarg);
-                    argsStmt.datasetS.key = std::string(optarg) + "_S";
+                    {
+                        // Dataset S path (repeat -S to join R with several datasets)
+                        DatasetStatement datasetS;
+                        datasetS.set = true;
+                        datasetS.nickname = std::string(optarg);
+                        datasetS.key = std::string(optarg) + "_S";
+                        argsStmt.datasetsS.emplace_back(datasetS);
+                    }
                     break;
                 case 'p':
                     g_config.indexConfig.partitionsPerDim = atoi(optarg);
@@ -186,20 +327,127 @@ namespace parse
                 case 'd':
                     argsStmt.outputStmt.documentType = std::string(optarg);
                     break;
+                case 'b':
+                    // use dataspace bounds sidecar files
+                    g_config.indexConfig.useBoundsSidecar = true;
+                    break;
+                case 'l':
+                    // lazy geometry materialization
+                    g_config.indexConfig.lazyGeometries = true;
+                    break;
+                case 'j':
+                    // batch mode: run the jobs of a job file
+                    jobFilePath = std::string(optarg);
+                    break;
+                case 'i':
+                    // index type
+                    g_config.indexConfig.indexType = mapping::indexTypeTextToInt(std::string(optarg));
+                    if (g_config.indexConfig.indexType == IT_INVALID) {
+                        logger::log_error(DBERR_INVALID_ARGS, "Invalid index type:", optarg, "(use UNIFORM_GRID, QUADTREE or RTREE)");
+                        return DBERR_INVALID_ARGS;
+                    }
+                    break;
+                case OPT_LEAF_CAPACITY:
+                    // quadtree leaf capacity
+                    if (atol(optarg) <= 0) {
+                        logger::log_error(DBERR_INVALID_ARGS, "Invalid leaf capacity:", optarg);
+                        return DBERR_INVALID_ARGS;
+                    }
+                    g_config.indexConfig.leafCapacity = atol(optarg);
+                    break;
+                case OPT_NODE_CAPACITY:
+                    // R-tree node capacity
+                    if (atol(optarg) < 2) {
+                        logger::log_error(DBERR_INVALID_ARGS, "Invalid node capacity:", optarg);
+                        return DBERR_INVALID_ARGS;
+                    }
+                    g_config.indexConfig.nodeCapacity = atol(optarg);
+                    break;
+                case OPT_RELATE:
+                    // refinement: full DE-9IM matrix, targeted predicates or both cross-checked
+                    g_config.indexConfig.relateMode = mapping::relateModeTextToInt(std::string(optarg));
+                    if (g_config.indexConfig.relateMode == RM_INVALID) {
+                        logger::log_error(DBERR_INVALID_ARGS, "Invalid relate mode:", optarg, "(use MATRIX, PREDICATES or CHECK)");
+                        return DBERR_INVALID_ARGS;
+                    }
+                    break;
+                case OPT_APRIL:
+                    // APRIL intermediate filter, with a grid of 2^order x 2^order cells
+                    if (atoi(optarg) < 1 || atoi(optarg) > april::MAX_ORDER) {
+                        logger::log_error(DBERR_INVALID_ARGS, "Invalid APRIL order:", optarg, "(use 1 to", april::MAX_ORDER, ")");
+                        return DBERR_INVALID_ARGS;
+                    }
+                    g_config.indexConfig.aprilOrder = atoi(optarg);
+                    break;
+                case OPT_APRIL_DIR:
+                    // read/store the APRIL approximations in a directory
+                    g_config.indexConfig.aprilDirectory = std::string(optarg);
+                    break;
+                case OPT_GEOMETRY_CACHE_MB:
+                    // memory cap of the geometry caches (lazy mode)
+                    g_config.indexConfig.geometryCacheBytes = (size_t) atol(optarg) * 1024 * 1024;
+                    break;
+                case OPT_SAVE_INDEX:
+                    // save the built index to a snapshot file
+                    g_config.indexConfig.saveIndexPath = std::string(optarg);
+                    break;
+                case OPT_LOAD_INDEX:
+                    // load the index from a snapshot file
+                    g_config.indexConfig.loadIndexPath = std::string(optarg);
+                    break;
                 default:
-                    logger::log_error(DBERR_INVALID_ARGS, "Unkown argument:", c);
+                    logger::log_error(DBERR_INVALID_ARGS, "Unkown argument:", (char) c);
                     return DBERR_INVALID_ARGS;
             }
         }
 
+        if (g_config.indexConfig.indexType != IT_UNIFORM_GRID && (g_config.indexConfig.saveIndexPath != "" || g_config.indexConfig.loadIndexPath != "")) {
+            logger::log_error(DBERR_INVALID_ARGS, "Index snapshots are only supported for the uniform grid index.");
+            return DBERR_INVALID_ARGS;
+        }
+        if (g_config.indexConfig.lazyGeometries && g_config.indexConfig.saveIndexPath != "") {
+            logger::log_error(DBERR_INVALID_ARGS, "Index snapshots can not be saved with lazy geometries (-l).");
+            return DBERR_INVALID_ARGS;
+        }
+
+        if (g_config.indexConfig.aprilDirectory != "") {
+            if (g_config.indexConfig.aprilOrder == 0) {
+                logger::log_error(DBERR_INVALID_ARGS, "An APRIL directory requires the APRIL filter (--april).");
+                return DBERR_INVALID_ARGS;
+            }
+            if (!verifyDirectory(g_config.indexConfig.aprilDirectory)) {
+                logger::log_error(DBERR_INVALID_ARGS, "APRIL directory does not exist:", g_config.indexConfig.aprilDirectory);
+                return DBERR_INVALID_ARGS;
+            }
+        }
+
+        if (jobFilePath != "") {
+            // batch mode, the datasets, grids and outputs are given by the job file
+            if (argsStmt.datasetR.set || !argsStmt.datasetsS.empty()) {
+                logger::log_error(DBERR_INVALID_ARGS, "A job file (-j) can not be combined with -R/-S.");
+                return DBERR_INVALID_ARGS;
+            }
+            if (g_config.indexConfig.saveIndexPath != "" || g_config.indexConfig.loadIndexPath != "") {
+                logger::log_error(DBERR_INVALID_ARGS, "Index snapshots are not supported with a job file (-j).");
+                return DBERR_INVALID_ARGS;
+            }
+            return loadJobFile(jobFilePath);
+        }
+
         // load metadata from datasets.ini
         ret = loadMetadata(argsStmt.datasetR);
         if (ret != DBERR_OK) {
             return ret;
         }
-        ret = loadMetadata(argsStmt.datasetS);
-        if (ret != DBERR_OK) {
-            return ret;
+        for (auto &datasetS : argsStmt.datasetsS) {
+            ret = loadMetadata(datasetS);
+            if (ret != DBERR_OK) {
+                return ret;
+            }
+        }
+        if (argsStmt.datasetsS.size() > 1 && (g_config.indexConfig.saveIndexPath != "" || g_config.indexConfig.loadIndexPath != "")) {
+            logger::log_error(DBERR_INVALID_ARGS, "Index snapshots are not supported with several S datasets.");
+            return DBERR_INVALID_ARGS;
         }
 
         // verify arguments
@@ -218,5 +466,24 @@ namespace parse
 
         return DBERR_OK;
     }
+
+    DB_STATUS parseDatasetStatement(std::string nickname, DatasetStatement &datasetStmt) {
+        DB_STATUS ret = DBERR_OK;
+        // open the config file parser
+        boost::property_tree::ini_parser::read_ini(g_config.dirPaths.datasetsConfigPath, dataset_config_pt);
+        datasetStmt.set = true;
+        datasetStmt.nickname = nickname;
+        datasetStmt.key = nickname;
+        ret = loadMetadata(datasetStmt);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        ret = verifyDatasetStatement(datasetStmt);
+        if (ret != DBERR_OK) {
+            logger::log_error(ret, "Failed while verifying dataset", nickname);
+            return ret;
+        }
+        return ret;
+    }
 }
 
@@ -36,6 +36,48 @@ bool verifyDirectory(std::string directoryPath) {
     }
 }
 
+DB_STATUS MappedFile::map(const std::string &filePath) {
+    fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        logger::log_error(DBERR_FILE_OPEN, "Failed to open file for mapping:", filePath);
+        return DBERR_FILE_OPEN;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        logger::log_error(DBERR_FILE_OPEN, "Failed to stat file:", filePath);
+        unmap();
+        return DBERR_FILE_OPEN;
+    }
+    size = st.st_size;
+    if (size == 0) {
+        // nothing to map
+        return DBERR_OK;
+    }
+    void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        logger::log_error(DBERR_FILE_OPEN, "Failed to memory-map file:", filePath);
+        size = 0;
+        unmap();
+        return DBERR_FILE_OPEN;
+    }
+    data = (const char*) addr;
+    // the loaders read the file front to back
+    madvise(addr, size, MADV_SEQUENTIAL);
+    return DBERR_OK;
+}
+
+void MappedFile::unmap() {
+    if (data != nullptr) {
+        munmap((void*) data, size);
+        data = nullptr;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    size = 0;
+}
+
 /** @brief Converts a degree area into a sq km area */
 double convertDegreesToSquareKilometers(double areaInDegrees, double lat) {
     // Earth's radius squared in square kilometers
@@ -132,44 +174,85 @@ namespace mapping
 
         return DOC_INVALID;
     }
+
+    std::string indexTypeIntToStr(IndexType indexType) {
+        switch(indexType) {
+            case IT_UNIFORM_GRID: return "UNIFORM_GRID";
+            case IT_QUADTREE: return "QUADTREE";
+            case IT_RTREE: return "RTREE";
+            default: return "";
+        }
+    }
+
+    IndexType indexTypeTextToInt(std::string str) {
+        if (str.compare("UNIFORM_GRID") == 0) return IT_UNIFORM_GRID;
+        else if (str.compare("QUADTREE") == 0) return IT_QUADTREE;
+        else if (str.compare("RTREE") == 0) return IT_RTREE;
+
+        return IT_INVALID;
+    }
+
+    std::string relateModeIntToStr(RelateMode relateMode) {
+        switch(relateMode) {
+            case RM_MATRIX: return "MATRIX";
+            case RM_PREDICATES: return "PREDICATES";
+            case RM_CHECK: return "CHECK";
+            default: return "";
+        }
+    }
+
+    RelateMode relateModeTextToInt(std::string str) {
+        if (str.compare("MATRIX") == 0) return RM_MATRIX;
+        else if (str.compare("PREDICATES") == 0) return RM_PREDICATES;
+        else if (str.compare("CHECK") == 0) return RM_CHECK;
+
+        return RM_INVALID;
+    }
 }
 
 namespace text_generator
 {   
-    std::string generateDirectionalRelation(std::string &entityNameR, std::string &entityNameS, CardinalDirection direction) {
+    std::string generateDirectionalRelation(std::string_view entityNameR, std::string_view entityNameS, CardinalDirection direction) {
         std::string directionText = mapping::cardinalDirectionIntToString(direction);
         if (directionText == "") {
             // don't generate a relation, empty direction
             return "";
         } else {
-            return entityNameR + " is " + directionText + " of " + entityNameS;
+            std::string text;
+            text.reserve(entityNameR.length() + directionText.length() + entityNameS.length() + 8);
+            text.append(entityNameR).append(" is ").append(directionText).append(" of ").append(entityNameS);
+            return text;
         }
     }
 
-    std::string generateTopologicalRelation(std::string &entityNameR, std::string &entityNameS, TopologyRelation relation) {
+    std::string generateTopologicalRelation(std::string_view entityNameR, std::string_view entityNameS, TopologyRelation relation) {
         std::string relationText = mapping::relationIntToStr(relation);
         if (relationText == "") {
             // don't generate a relation
             return "";
         } else {
-            return entityNameR + " " + relationText + " " + entityNameS + ". ";
+            std::string text;
+            text.reserve(entityNameR.length() + relationText.length() + entityNameS.length() + 4);
+            text.append(entityNameR).append(" ").append(relationText).append(" ").append(entityNameS).append(". ");
+            return text;
         }
     }
 
-    std::string generateCombinedTopologicalRelation(std::string &entityNameR, std::string &entityNameS, TopologyRelation relation, CardinalDirection direction, std::string area) {
+    std::string generateCombinedTopologicalRelation(std::string_view entityNameR, std::string_view entityNameS, TopologyRelation relation, CardinalDirection direction, std::string area) {
         std::string relationText = mapping::relationIntToStr(relation);
         std::string returnText = "";
         if (relationText == "") {
             // don't generate a relation
             return returnText;
         } else {
-            returnText = entityNameR + " " + relationText;
+            returnText.reserve(entityNameR.length() + relationText.length() + entityNameS.length() + area.length() + 64);
+            returnText.append(entityNameR).append(" ").append(relationText);
             if (direction != CD_NONE) {
                 std::string directionText = mapping::cardinalDirectionIntToString(direction);
                 // generate direction text
-                returnText += " and " + directionText + " of " + entityNameS;
+                returnText.append(" and ").append(directionText).append(" of ").append(entityNameS);
             } else {
-                returnText += " " + entityNameS;
+                returnText.append(" ").append(entityNameS);
             }
 
             if (area != "") {
@@ -183,13 +266,15 @@ namespace text_generator
         return returnText;
     }
 
-    std::string generateAreaInSqkm(std::string &entityNameR, std::string &entityNameS, double area) {
+    std::string generateAreaInSqkm(std::string_view entityNameR, std::string_view entityNameS, double area) {
         if (area < EPS) {
             return "";
         } else {
             std::stringstream stream;
             stream << std::fixed << std::setprecision(2) << area;
-            return entityNameR + " and " + entityNameS + " have approximately " + stream.str() + " square kilometers of common area. ";
+            std::string text;
+            text.append(entityNameR).append(" and ").append(entityNameS).append(" have approximately ").append(stream.str()).append(" square kilometers of common area. ");
+            return text;
         }
     }
 }
@@ -258,16 +343,6 @@ TopologyRelation getSwappedTopologyRelation(TopologyRelation relation) {
     return TR_INVALID;
 }
 
-DB_STATUS splitString(std::string &input, char delimiter, std::vector<std::string> &tokens) {
-    DB_STATUS ret = DBERR_OK;
-    std::istringstream stream(input);
-    std::string token;
-    while (getline(stream, token, delimiter)) {
-        tokens.emplace_back(token);
-    }
-    return ret;
-}
-
 namespace state
 {
     std::string stateFpToStateName(int stateFP) {
@@ -0,0 +1,240 @@
+#include "wkt.h"
+#include "utils.h"
+
+namespace wkt
+{
+    /** @brief Read position in a WKT text. */
+    struct Cursor {
+        const char* pos;
+        const char* end;
+
+        explicit Cursor(std::string_view text) : pos(text.data()), end(text.data() + text.size()) {}
+    };
+
+    static inline void skipSpaces(Cursor &cur) {
+        while (cur.pos < cur.end && (*cur.pos == ' ' || *cur.pos == '\t' || *cur.pos == '\r' || *cur.pos == '\n')) {
+            cur.pos++;
+        }
+    }
+
+    /** @brief Consumes the given character (after any whitespace) if it is next in the text. */
+    static inline bool consume(Cursor &cur, char c) {
+        skipSpaces(cur);
+        if (cur.pos < cur.end && *cur.pos == c) {
+            cur.pos++;
+            return true;
+        }
+        return false;
+    }
+
+    /** @brief Reads the next word (letters only), e.g. a geometry tag or 'EMPTY'. */
+    static inline std::string_view readTag(Cursor &cur) {
+        skipSpaces(cur);
+        const char* start = cur.pos;
+        while (cur.pos < cur.end && std::isalpha((unsigned char) *cur.pos)) {
+            cur.pos++;
+        }
+        return std::string_view(start, cur.pos - start);
+    }
+
+    /** @brief Case-insensitive comparison of a tag read from the text with an (upper case) tag. */
+    static inline bool equalsTag(std::string_view tag, std::string_view expected) {
+        if (tag.size() != expected.size()) {
+            return false;
+        }
+        for (size_t i=0; i<tag.size(); i++) {
+            if (std::toupper((unsigned char) tag[i]) != expected[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static inline bool readNumber(Cursor &cur, double &value) {
+        skipSpaces(cur);
+        if (cur.pos < cur.end && *cur.pos == '+') {
+            // from_chars does not accept an explicit plus sign
+            cur.pos++;
+        }
+        auto result = std::from_chars(cur.pos, cur.end, value);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        cur.pos = result.ptr;
+        return true;
+    }
+
+    /** @brief Returns the number of points in the point sequence that starts at the cursor (up to the closing parenthesis). */
+    static inline size_t countPoints(const Cursor &cur) {
+        size_t count = 1;
+        for (const char* p = cur.pos; p < cur.end && *p != ')'; p++) {
+            if (*p == ',') {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /** @brief Reads a parenthesized point sequence '(x y, x y, ...)' and appends it to the range (linestring/ring). */
+    template<typename Range>
+    static inline bool readPointSequence(Cursor &cur, Range &range) {
+        if (!consume(cur, '(')) {
+            return false;
+        }
+        range.reserve(range.size() + countPoints(cur));
+        do {
+            double x, y;
+            if (!readNumber(cur, x) || !readNumber(cur, y)) {
+                return false;
+            }
+            range.emplace_back(x, y);
+        } while (consume(cur, ','));
+        return consume(cur, ')');
+    }
+
+    /** @brief Reads a polygon body '((outer), (inner), ...)'. */
+    static inline bool readPolygon(Cursor &cur, bg_polygon &polygon) {
+        if (!consume(cur, '(')) {
+            return false;
+        }
+        if (!readPointSequence(cur, polygon.outer())) {
+            return false;
+        }
+        while (consume(cur, ',')) {
+            polygon.inners().emplace_back();
+            if (!readPointSequence(cur, polygon.inners().back())) {
+                return false;
+            }
+        }
+        return consume(cur, ')');
+    }
+
+    /**
+    @brief Reads the geometry tag, which must match the expected one, and an optional 'EMPTY' marker.
+     * @param[out] empty Set to true if the geometry is empty.
+     * @return DBERR_INVALID_GEOMETRY if the tag is different or has unsupported dimensions (e.g. Z/M).
+     */
+    static inline DB_STATUS readHeader(Cursor &cur, std::string_view expectedTag, bool &empty) {
+        if (!equalsTag(readTag(cur), expectedTag)) {
+            return DBERR_INVALID_GEOMETRY;
+        }
+        std::string_view marker = readTag(cur);
+        if (marker.empty()) {
+            empty = false;
+            return DBERR_OK;
+        }
+        // anything other than EMPTY (e.g. Z/M dimensions) is unsupported
+        empty = equalsTag(marker, "EMPTY");
+        return empty ? DBERR_OK : DBERR_INVALID_GEOMETRY;
+    }
+
+    /** @brief True if only whitespace remains in the text. */
+    static inline bool finished(Cursor &cur) {
+        skipSpaces(cur);
+        return cur.pos == cur.end;
+    }
+
+    DataType getDataType(std::string_view wktText) {
+        Cursor cur(wktText);
+        std::string_view tag = readTag(cur);
+        if (equalsTag(tag, "POLYGON")) return DT_POLYGON;
+        else if (equalsTag(tag, "MULTIPOLYGON")) return DT_MULTIPOLYGON;
+        else if (equalsTag(tag, "POINT")) return DT_POINT;
+        else if (equalsTag(tag, "LINESTRING")) return DT_LINESTRING;
+        // fall back to the generic mapping (reports unknown types)
+        return mapping::dataTypeTextToInt(std::string(tag));
+    }
+
+    DB_STATUS parse(std::string_view wktText, bg_point_xy &geometry) {
+        Cursor cur(wktText);
+        bool empty;
+        DB_STATUS ret = readHeader(cur, "POINT", empty);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        if (empty) {
+            // an empty point/box can not be represented
+            return DBERR_INVALID_GEOMETRY;
+        }
+        double x, y;
+        if (!consume(cur, '(') || !readNumber(cur, x) || !readNumber(cur, y) || !consume(cur, ')') || !finished(cur)) {
+            return DBERR_INVALID_WKT;
+        }
+        geometry = bg_point_xy(x, y);
+        return DBERR_OK;
+    }
+
+    DB_STATUS parse(std::string_view wktText, bg_linestring &geometry) {
+        Cursor cur(wktText);
+        bool empty;
+        DB_STATUS ret = readHeader(cur, "LINESTRING", empty);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        boost::geometry::clear(geometry);
+        if (!empty && !readPointSequence(cur, geometry)) {
+            return DBERR_INVALID_WKT;
+        }
+        return finished(cur) ? DBERR_OK : DBERR_INVALID_WKT;
+    }
+
+    DB_STATUS parse(std::string_view wktText, bg_rectangle &geometry) {
+        Cursor cur(wktText);
+        bool empty;
+        DB_STATUS ret = readHeader(cur, "BOX", empty);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        if (empty) {
+            // an empty point/box can not be represented
+            return DBERR_INVALID_GEOMETRY;
+        }
+        double xMin, yMin, xMax, yMax;
+        if (!consume(cur, '(') || !readNumber(cur, xMin) || !readNumber(cur, yMin) || !consume(cur, ',') ||
+            !readNumber(cur, xMax) || !readNumber(cur, yMax) || !consume(cur, ')') || !finished(cur)) {
+            return DBERR_INVALID_WKT;
+        }
+        geometry.min_corner() = bg_point_xy(xMin, yMin);
+        geometry.max_corner() = bg_point_xy(xMax, yMax);
+        return DBERR_OK;
+    }
+
+    DB_STATUS parse(std::string_view wktText, bg_polygon &geometry) {
+        Cursor cur(wktText);
+        bool empty;
+        DB_STATUS ret = readHeader(cur, "POLYGON", empty);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        boost::geometry::clear(geometry);
+        if (!empty && !readPolygon(cur, geometry)) {
+            return DBERR_INVALID_WKT;
+        }
+        return finished(cur) ? DBERR_OK : DBERR_INVALID_WKT;
+    }
+
+    DB_STATUS parse(std::string_view wktText, bg_multi_polygon &geometry) {
+        Cursor cur(wktText);
+        bool empty;
+        DB_STATUS ret = readHeader(cur, "MULTIPOLYGON", empty);
+        if (ret != DBERR_OK) {
+            return ret;
+        }
+        boost::geometry::clear(geometry);
+        if (!empty) {
+            if (!consume(cur, '(')) {
+                return DBERR_INVALID_WKT;
+            }
+            do {
+                geometry.emplace_back();
+                if (!readPolygon(cur, geometry.back())) {
+                    return DBERR_INVALID_WKT;
+                }
+            } while (consume(cur, ','));
+            if (!consume(cur, ')')) {
+                return DBERR_INVALID_WKT;
+            }
+        }
+        return finished(cur) ? DBERR_OK : DBERR_INVALID_WKT;
+    }
+}
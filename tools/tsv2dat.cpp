@@ -0,0 +1,69 @@
+#include "utils.h"
+#include "parse.h"
+#include "loader.h"
+#include "binary.h"
+
+/** @brief Converts a TSV/WKT dataset (as defined in datasets.ini) to the binary (.dat) dataset format. 
+ * Usage: ./tsv2dat -R <dataset nickname> -o <output .dat path> [-t <threads>]
+ */
+int main(int argc, char *argv[]) {
+    clock_t timer;
+    DB_STATUS ret = DBERR_OK;
+    std::string nickname = "";
+    std::string outputPath = "";
+    char c;
+
+    while ((c = getopt(argc, argv, "R:o:t:?")) != -1)
+    {
+        switch (c)
+        {
+            case 'R':
+                nickname = std::string(optarg);
+                break;
+            case 'o':
+                outputPath = std::string(optarg);
+                break;
+            case 't':
+                g_config.setNumThreads(atoi(optarg));
+                break;
+            default:
+                logger::log_error(DBERR_INVALID_ARGS, "Unkown argument:", c);
+                return DBERR_INVALID_ARGS;
+        }
+    }
+    if (nickname == "" || outputPath == "") {
+        logger::log_error(DBERR_INVALID_ARGS, "Usage: ./tsv2dat -R <dataset nickname> -o <output .dat path> [-t <threads>]");
+        return DBERR_INVALID_ARGS;
+    }
+
+    DatasetStatement datasetStmt;
+    ret = parse::parseDatasetStatement(nickname, datasetStmt);
+    if (ret != DBERR_OK) {
+        logger::log_error(ret, "Parsing dataset", nickname, "failed.");
+        return ret;
+    }
+    if (datasetStmt.fileFormat != FT_WKT) {
+        logger::log_error(DBERR_INVALID_ARGS, "Only TSV/WKT datasets can be converted:", datasetStmt.path);
+        return DBERR_INVALID_ARGS;
+    }
+    Dataset dataset(datasetStmt);
+
+    // load
+    timer = clock();
+    std::vector<std::vector<Shape>> chunkObjects;
+    ret = loader::loadDataset(&dataset, chunkObjects);
+    if (ret != DBERR_OK) {
+        logger::log_error(ret, "Failed while loading dataset", nickname);
+        return ret;
+    }
+    logger::log_success("Loaded dataset", nickname, "in", (clock()-timer) / (double)(CLOCKS_PER_SEC), "seconds");
+
+    // write
+    ret = binary::writeDataset(outputPath, chunkObjects);
+    if (ret != DBERR_OK) {
+        logger::log_error(ret, "Failed while writing binary dataset", outputPath);
+        return ret;
+    }
+
+    return 0;
+}